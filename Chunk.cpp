@@ -0,0 +1,147 @@
+#include "Chunk.h"
+
+namespace {
+
+    // Append one merged quad lying on the plane between slice and slice + side along axis d
+    void EmitQuad(ChunkMeshData& out, const glm::ivec3& chunkOrigin, int d, int u, int v, int side,
+                  int slice, int i, int j, int w, int h) {
+        glm::vec3 base = glm::vec3(chunkOrigin);
+        base[d] += slice + side * 0.5f;
+        base[u] += i - 0.5f;
+        base[v] += j - 0.5f;
+
+        glm::vec3 du(0.0f);
+        du[u] = (float)w;
+        glm::vec3 dv(0.0f);
+        dv[v] = (float)h;
+
+        glm::vec3 normal(0.0f);
+        normal[d] = (float)side;
+
+        const glm::vec3 corners[4] = { base, base + du, base + du + dv, base + dv };
+        const glm::vec2 extents[4] = {
+            glm::vec2(0.0f, 0.0f), glm::vec2((float)w, 0.0f),
+            glm::vec2((float)w, (float)h), glm::vec2(0.0f, (float)h)
+        };
+
+        unsigned int first = static_cast<unsigned int>(out.vertices.size() / 8);
+        for (int c = 0; c < 4; c++) {
+            // Texture repeats once per block; keep t running up the side faces
+            glm::vec2 uv = (d == 2) ? extents[c] : glm::vec2(extents[c].y, extents[c].x);
+
+            out.vertices.push_back(corners[c].x);
+            out.vertices.push_back(corners[c].y);
+            out.vertices.push_back(corners[c].z);
+            out.vertices.push_back(normal.x);
+            out.vertices.push_back(normal.y);
+            out.vertices.push_back(normal.z);
+            out.vertices.push_back(uv.x);
+            out.vertices.push_back(uv.y);
+        }
+
+        // du x dv points along +d, so flip the winding for faces looking down the axis
+        if (side > 0) {
+            unsigned int quad[] = { 0, 1, 2, 2, 3, 0 };
+            for (unsigned int q : quad) out.indices.push_back(first + q);
+        }
+        else {
+            unsigned int quad[] = { 0, 3, 2, 2, 1, 0 };
+            for (unsigned int q : quad) out.indices.push_back(first + q);
+        }
+    }
+
+}
+
+void ChunkMesher::Build(const std::vector<BlockType>& padded, const glm::ivec3& chunkOrigin, ChunkMeshData& out,
+                        bool worldFloor) {
+    out.vertices.clear();
+    out.indices.clear();
+
+    std::vector<BlockType> mask(CHUNK_SIZE * CHUNK_SIZE);
+
+    for (int d = 0; d < 3; d++) {
+        int u = (d + 1) % 3;
+        int v = (d + 2) % 3;
+
+        for (int side = -1; side <= 1; side += 2) {
+            for (int slice = 0; slice < CHUNK_SIZE; slice++) {
+                // The underside of the world: no camera ever looks up at it
+                if (worldFloor && d == 1 && side < 0 && slice == 0) continue;
+
+                // Mark every solid block in this slice whose neighbour across the face is air
+                int n = 0;
+                for (int j = 0; j < CHUNK_SIZE; j++) {
+                    for (int i = 0; i < CHUNK_SIZE; i++) {
+                        glm::ivec3 p;
+                        p[d] = slice;
+                        p[u] = i;
+                        p[v] = j;
+                        glm::ivec3 q = p;
+                        q[d] += side;
+
+                        BlockType block = padded[PaddedIndex(p.x, p.y, p.z)];
+                        BlockType neighbour = padded[PaddedIndex(q.x, q.y, q.z)];
+                        mask[n++] = (block != BlockType::Air && neighbour == BlockType::Air) ? block : BlockType::Air;
+                    }
+                }
+
+                // Grow each unvisited face into the widest, then tallest, rectangle of the same type
+                n = 0;
+                for (int j = 0; j < CHUNK_SIZE; j++) {
+                    for (int i = 0; i < CHUNK_SIZE;) {
+                        BlockType type = mask[n];
+                        if (type == BlockType::Air) {
+                            i++;
+                            n++;
+                            continue;
+                        }
+
+                        int w = 1;
+                        while (i + w < CHUNK_SIZE && mask[n + w] == type) {
+                            w++;
+                        }
+
+                        int h = 1;
+                        for (; j + h < CHUNK_SIZE; h++) {
+                            bool rowMatches = true;
+                            for (int k = 0; k < w; k++) {
+                                if (mask[n + k + h * CHUNK_SIZE] != type) {
+                                    rowMatches = false;
+                                    break;
+                                }
+                            }
+                            if (!rowMatches) break;
+                        }
+
+                        EmitQuad(out, chunkOrigin, d, u, v, side, slice, i, j, w, h);
+
+                        for (int l = 0; l < h; l++) {
+                            for (int k = 0; k < w; k++) {
+                                mask[n + k + l * CHUNK_SIZE] = BlockType::Air;
+                            }
+                        }
+
+                        i += w;
+                        n += w;
+                    }
+                }
+            }
+        }
+    }
+}
+
+Chunk::Chunk(const glm::ivec3& coord)
+    : m_coord(coord), m_blocks(CHUNK_VOLUME, BlockType::Air), m_solidCount(0), m_dirty(true)
+{
+}
+
+void Chunk::SetBlock(int x, int y, int z, BlockType type) {
+    BlockType& block = m_blocks[Index(x, y, z)];
+    if (block == type) return;
+
+    if (block == BlockType::Air) m_solidCount++;
+    if (type == BlockType::Air) m_solidCount--;
+
+    block = type;
+    m_dirty = true;
+}
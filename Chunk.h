@@ -0,0 +1,87 @@
+#pragma once
+
+#include "MeshPool.h"
+#include "SceneOctree.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+enum class BlockType : uint8_t {
+    Air = 0,
+    Container = 1
+};
+
+const int CHUNK_SIZE = 16;
+const int CHUNK_VOLUME = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+// Chunk blocks plus a one-block border taken from the neighbouring chunks,
+// so a chunk can be meshed without looking anything up in the world
+// Chunk row holding the world's lowest block layer. Nothing is below it, so
+// faces looking down from that layer are never seen.
+const int WORLD_FLOOR_CHUNK_Y = 0;
+
+const int PADDED_CHUNK_SIZE = CHUNK_SIZE + 2;
+const int PADDED_CHUNK_VOLUME = PADDED_CHUNK_SIZE * PADDED_CHUNK_SIZE * PADDED_CHUNK_SIZE;
+
+inline int PaddedIndex(int x, int y, int z) {
+    return (x + 1) + (y + 1) * PADDED_CHUNK_SIZE + (z + 1) * PADDED_CHUNK_SIZE * PADDED_CHUNK_SIZE;
+}
+
+// CPU-side mesh: pos(3), normal(3), uv(2) per vertex, same layout as the cube VAO
+struct ChunkMeshData {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+};
+
+class ChunkMesher {
+public:
+    // Greedy mesher: emits only faces between a solid block and air, merging
+    // coplanar faces of the same block type into as few quads as possible.
+    // worldFloor drops the downward faces of the chunk's bottom layer.
+    static void Build(const std::vector<BlockType>& padded, const glm::ivec3& chunkOrigin, ChunkMeshData& out,
+                      bool worldFloor = false);
+};
+
+class Chunk {
+public:
+    Chunk(const glm::ivec3& coord);
+
+    Chunk(const Chunk&) = delete;
+    Chunk& operator=(const Chunk&) = delete;
+
+    BlockType GetBlock(int x, int y, int z) const { return m_blocks[Index(x, y, z)]; }
+    void SetBlock(int x, int y, int z, BlockType type);
+
+    bool IsEmpty() const { return m_solidCount == 0; }
+    bool IsDirty() const { return m_dirty; }
+    void MarkDirty() { m_dirty = true; }
+
+    // Cached mesh in the world's MeshPool; setting it clears the dirty flag
+    const MeshRange& GetMesh() const { return m_mesh; }
+    void SetMesh(const MeshRange& mesh) { m_mesh = mesh; m_dirty = false; }
+
+    glm::ivec3 GetCoord() const { return m_coord; }
+    glm::ivec3 GetOrigin() const { return m_coord * CHUNK_SIZE; }
+    unsigned int GetIndexCount() const { return m_mesh.indexCount; }
+
+    // World-space box around the mesh, set together with it
+    const glm::vec3& GetBoundsCenter() const { return m_boundsCenter; }
+    const glm::vec3& GetBoundsExtent() const { return m_boundsExtent; }
+    void SetBounds(const glm::vec3& center, const glm::vec3& extent) { m_boundsCenter = center; m_boundsExtent = extent; }
+
+    // Entry in the world's scene index while the chunk has a mesh
+    SceneHandle GetSceneHandle() const { return m_sceneHandle; }
+    void SetSceneHandle(SceneHandle handle) { m_sceneHandle = handle; }
+
+private:
+    glm::ivec3 m_coord;
+    std::vector<BlockType> m_blocks;
+    int m_solidCount;
+    bool m_dirty;
+    MeshRange m_mesh;
+    SceneHandle m_sceneHandle = INVALID_SCENE_HANDLE;
+    glm::vec3 m_boundsCenter = glm::vec3(0.0f);
+    glm::vec3 m_boundsExtent = glm::vec3(0.0f);
+
+    static int Index(int x, int y, int z) { return x + y * CHUNK_SIZE + z * CHUNK_SIZE * CHUNK_SIZE; }
+};
@@ -0,0 +1,153 @@
+#include "DeferredShading.h"
+#include "Lighting.h"
+#include <iostream>
+
+namespace {
+
+    // The lighting passes read the G-buffer and never touch depth
+    PipelineStateDesc LightPipelineDesc() {
+        PipelineStateDesc desc;
+        desc.depthTest = false;
+        desc.depthWrite = false;
+        return desc;
+    }
+
+    PipelineStateDesc LightVolumePipelineDesc() {
+        PipelineStateDesc desc = LightPipelineDesc();
+        desc.blend = true;
+        desc.blendSrc = GL_ONE;
+        desc.blendDst = GL_ONE;
+        return desc;
+    }
+
+    struct AttachmentFormat {
+        GLenum internalFormat;
+        GLenum format;
+        GLenum type;
+        GLenum attachment;
+    };
+
+    const AttachmentFormat ATTACHMENT_FORMATS[] = {
+        { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT0 },
+        { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT1 },
+        { GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, GL_COLOR_ATTACHMENT2 },
+        { GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_DEPTH_STENCIL_ATTACHMENT }
+    };
+
+    const unsigned int ATTACHMENT_UNITS[] = {
+        DeferredShading::COLOR_TEXTURE_UNIT,
+        DeferredShading::ALBEDO_SPEC_TEXTURE_UNIT,
+        DeferredShading::NORMAL_TEXTURE_UNIT,
+        DeferredShading::DEPTH_TEXTURE_UNIT
+    };
+
+}
+
+DeferredShading::DeferredShading()
+    : m_framebuffer(0), m_width(0), m_height(0),
+      m_lightShader("resources/Shaders/deferred_light.glsl"),
+      m_pointLightShader("resources/Shaders/deferred_point_light.glsl"),
+      m_emptyVAO(0),
+      m_lightPipeline(LightPipelineDesc()),
+      m_lightVolumePipeline(LightVolumePipelineDesc()),
+      m_lightVolumeCount(0)
+{
+    glGenFramebuffers(1, &m_framebuffer);
+    glGenTextures(ATTACHMENT_COUNT, m_textures);
+    glGenVertexArrays(1, &m_emptyVAO);
+
+    m_lightShader.Use();
+    m_lightShader.SetInt("u_gColor", COLOR_TEXTURE_UNIT);
+    m_lightShader.SetInt("u_gAlbedoSpec", ALBEDO_SPEC_TEXTURE_UNIT);
+    m_lightShader.SetInt("u_gNormal", NORMAL_TEXTURE_UNIT);
+    m_lightShader.SetInt("u_gDepth", DEPTH_TEXTURE_UNIT);
+
+    m_pointLightShader.Use();
+    m_pointLightShader.SetInt("u_pointLights", Lighting::POINT_LIGHT_TEXTURE_UNIT);
+    m_pointLightShader.SetInt("u_gAlbedoSpec", ALBEDO_SPEC_TEXTURE_UNIT);
+    m_pointLightShader.SetInt("u_gNormal", NORMAL_TEXTURE_UNIT);
+    m_pointLightShader.SetInt("u_gDepth", DEPTH_TEXTURE_UNIT);
+
+    m_lightInvViewProj = m_lightShader.GetUniform<glm::mat4>("u_invViewProj");
+    m_lightShininess = m_lightShader.GetUniform<float>("u_shininess");
+    m_pointLightInvViewProj = m_pointLightShader.GetUniform<glm::mat4>("u_invViewProj");
+    m_pointLightShininess = m_pointLightShader.GetUniform<float>("u_shininess");
+}
+
+DeferredShading::~DeferredShading() {
+    glDeleteFramebuffers(1, &m_framebuffer);
+    glDeleteTextures(ATTACHMENT_COUNT, m_textures);
+    for (unsigned int texture : m_textures) {
+        Renderer::OnTextureDeleted(texture);
+    }
+    glDeleteVertexArrays(1, &m_emptyVAO);
+    Renderer::OnVertexArrayDeleted(m_emptyVAO);
+}
+
+bool DeferredShading::IsValid() const {
+    return m_lightShader.IsValid() && m_pointLightShader.IsValid();
+}
+
+void DeferredShading::Resize(int width, int height) {
+    m_width = width;
+    m_height = height;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    for (int i = 0; i < ATTACHMENT_COUNT; i++) {
+        const AttachmentFormat& format = ATTACHMENT_FORMATS[i];
+        Renderer::BindTextureForUpdate(ATTACHMENT_UNITS[i], GL_TEXTURE_2D, m_textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, format.internalFormat, width, height, 0, format.format, format.type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, format.attachment, GL_TEXTURE_2D, m_textures[i], 0);
+    }
+
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+    glDrawBuffers(3, drawBuffers);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "DeferredShading: G-buffer incomplete at " << width << "x" << height << std::endl;
+    }
+}
+
+void DeferredShading::BeginGeometryPass(int width, int height, const glm::vec4& clearColor) {
+    if (width != m_width || height != m_height) {
+        Resize(width, height);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+
+    // Targets 1 and 2 clear to zero, which leaves the background unshaded.
+    // The caller's pipeline state decides which masks are open.
+    const GLfloat zero[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 0, &clearColor[0]);
+    glClearBufferfv(GL_COLOR, 1, zero);
+    glClearBufferfv(GL_COLOR, 2, zero);
+    glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+}
+
+void DeferredShading::LightingPass(const Lighting& lighting, const glm::mat4& viewProjection, float shininess) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    for (int i = 0; i < ATTACHMENT_COUNT; i++) {
+        Renderer::BindTexture(ATTACHMENT_UNITS[i], GL_TEXTURE_2D, m_textures[i]);
+    }
+    Renderer::BindTexture(Lighting::POINT_LIGHT_TEXTURE_UNIT, GL_TEXTURE_BUFFER, lighting.GetPointLightTexture());
+    Renderer::BindVertexArray(m_emptyVAO);
+    glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+
+    // Every pixel once: base colour plus the flashlight
+    Renderer::ApplyPipelineState(m_lightPipeline);
+    m_lightShader.Use();
+    m_lightShader.Set(m_lightInvViewProj, inverseViewProjection);
+    m_lightShader.Set(m_lightShininess, shininess);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    // Point lights, each bounded to its sphere's screen rectangle
+    m_lightVolumeCount = lighting.GetPointLightCount();
+    if (m_lightVolumeCount == 0) return;
+
+    Renderer::ApplyPipelineState(m_lightVolumePipeline);
+    m_pointLightShader.Use();
+    m_pointLightShader.Set(m_pointLightInvViewProj, inverseViewProjection);
+    m_pointLightShader.Set(m_pointLightShininess, shininess);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, m_lightVolumeCount);
+}
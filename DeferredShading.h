@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Renderer.h"
+#include "Shader.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class Lighting;
+
+// Deferred renderer path. The geometry pass draws the opaque scene into a
+// compact G-buffer (colour, albedo + specular, normal, depth-stencil; 16
+// bytes a pixel), so overdraw costs a few texture writes instead of the full
+// lighting loop. The lighting pass then shades each pixel once: a fullscreen
+// triangle adds the flashlight, and each point light draws one screen
+// rectangle bounding its sphere, additively blended, all in one instanced call.
+//
+// Programs drawn while the G-buffer is bound write all three colour targets;
+// gbuffer_shader.glsl marks its pixels for shading, programs that light
+// themselves write their colour to target 0 and zero to the others.
+class DeferredShading {
+public:
+    // G-buffer textures are read from these units during the lighting pass
+    static const unsigned int COLOR_TEXTURE_UNIT = 8;
+    static const unsigned int ALBEDO_SPEC_TEXTURE_UNIT = 9;
+    static const unsigned int NORMAL_TEXTURE_UNIT = 10;
+    static const unsigned int DEPTH_TEXTURE_UNIT = 11;
+
+    DeferredShading();
+    ~DeferredShading();
+
+    DeferredShading(const DeferredShading&) = delete;
+    DeferredShading& operator=(const DeferredShading&) = delete;
+
+    bool IsValid() const;
+
+    // Bind the G-buffer, resized to the framebuffer if needed, and clear it
+    void BeginGeometryPass(int width, int height, const glm::vec4& clearColor);
+
+    // Shade the G-buffer into the default framebuffer. Expects the camera
+    // block and the lights of this frame to be uploaded already.
+    void LightingPass(const Lighting& lighting, const glm::mat4& viewProjection, float shininess);
+
+    // Point light rectangles drawn by the last lighting pass
+    int GetLightVolumeCount() const { return m_lightVolumeCount; }
+
+private:
+    enum Attachment { COLOR = 0, ALBEDO_SPEC, NORMAL, DEPTH, ATTACHMENT_COUNT };
+
+    unsigned int m_framebuffer;
+    unsigned int m_textures[ATTACHMENT_COUNT];
+    int m_width, m_height;
+
+    Shader m_lightShader;
+    Shader m_pointLightShader;
+    Uniform<glm::mat4> m_lightInvViewProj, m_pointLightInvViewProj;
+    Uniform<float> m_lightShininess, m_pointLightShininess;
+    unsigned int m_emptyVAO; // the lighting passes build their vertices from gl_VertexID
+    PipelineState m_lightPipeline;
+    PipelineState m_lightVolumePipeline;
+
+    int m_lightVolumeCount;
+
+    void Resize(int width, int height);
+};
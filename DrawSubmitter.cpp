@@ -0,0 +1,116 @@
+#include "DrawSubmitter.h"
+#include "Renderer.h"
+#include "RingBuffer.h"
+#include "NormalMatrices.h"
+#include <algorithm>
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 5 * sizeof(GLuint), "Indirect command must be tightly packed");
+static_assert(sizeof(DrawData) == 9 * sizeof(glm::vec4), "Shaders expect nine texels per draw");
+
+DrawSubmitter::DrawSubmitter()
+    : m_multiDrawIndirect(Renderer::GetCaps().multiDrawIndirect),
+      m_drawDataTexture(0), m_drawDataSource(0), m_drawIdBuffer(0), m_drawIdCapacity(0),
+      m_frameDraws(0), m_frameCalls(0), m_frameIdentityNormals(0)
+{
+    glGenTextures(1, &m_drawDataTexture);
+
+    if (m_multiDrawIndirect) {
+        glGenBuffers(1, &m_drawIdBuffer);
+        ReserveDrawIds(4096);
+    }
+}
+
+DrawSubmitter::~DrawSubmitter() {
+    glDeleteTextures(1, &m_drawDataTexture);
+    Renderer::OnTextureDeleted(m_drawDataTexture);
+    if (m_multiDrawIndirect) {
+        glDeleteBuffers(1, &m_drawIdBuffer);
+    }
+}
+
+void DrawSubmitter::ReserveDrawIds(unsigned int count) {
+    if (count <= m_drawIdCapacity) return;
+    count = std::max(count, m_drawIdCapacity * 2);
+
+    // Identity table: instance i of a draw with baseInstance b reads id b + i
+    std::vector<GLuint> ids(count);
+    for (unsigned int i = 0; i < count; i++) {
+        ids[i] = i;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_drawIdBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, count * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+    m_drawIdCapacity = count;
+}
+
+void DrawSubmitter::AttachToVertexArray(unsigned int vao) {
+    // The fallback path leaves the attribute disabled and sets its constant value per draw
+    if (!m_multiDrawIndirect) return;
+
+    Renderer::BindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_drawIdBuffer);
+    glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+    glEnableVertexAttribArray(DRAW_ID_LOCATION);
+    glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+    Renderer::BindVertexArray(0);
+}
+
+void DrawSubmitter::Add(unsigned int indexCount, unsigned int firstIndex, int baseVertex, const DrawData& data) {
+    GLuint drawID = static_cast<GLuint>(m_commands.size());
+    m_commands.push_back({ indexCount, 1, firstIndex, baseVertex, drawID });
+    m_drawData.push_back(data);
+}
+
+void DrawSubmitter::Submit() {
+    if (m_commands.empty()) return;
+
+    GLsizei drawCount = static_cast<GLsizei>(m_commands.size());
+
+    // One batched pass instead of an inverse per vertex in the shaders
+    m_frameIdentityNormals += static_cast<int>(NormalMatrices::Compute(
+        &m_drawData[0].model, sizeof(DrawData), m_drawData[0].normalMatrix, sizeof(DrawData), m_drawData.size()));
+
+    size_t dataSize = m_drawData.size() * sizeof(DrawData);
+    size_t commandSize = m_multiDrawIndirect ? m_commands.size() * sizeof(DrawElementsIndirectCommand) : 0;
+
+    // Both writes must land in the same buffer
+    RingBuffer& ring = Renderer::GetFrameRing();
+    if (!ring.Reserve(dataSize + sizeof(DrawData) + commandSize + sizeof(GLuint))) {
+        m_commands.clear();
+        m_drawData.clear();
+        return;
+    }
+    GLuint firstDrawID = static_cast<GLuint>(ring.Write(m_drawData.data(), dataSize, sizeof(DrawData)) / sizeof(DrawData));
+
+    if (m_drawDataSource != ring.GetGeneration()) {
+        Renderer::BindTextureForUpdate(DRAW_DATA_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_drawDataTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, ring.GetID());
+        m_drawDataSource = ring.GetGeneration();
+    }
+    Renderer::BindTexture(DRAW_DATA_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_drawDataTexture);
+
+    if (m_multiDrawIndirect) {
+        ReserveDrawIds(firstDrawID + drawCount);
+
+        for (DrawElementsIndirectCommand& command : m_commands) {
+            command.baseInstance += firstDrawID;
+        }
+        size_t commandOffset = ring.Write(m_commands.data(), commandSize, sizeof(GLuint));
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ring.GetID());
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)commandOffset, drawCount, 0);
+        m_frameCalls++;
+    }
+    else {
+        for (GLsizei i = 0; i < drawCount; i++) {
+            const DrawElementsIndirectCommand& command = m_commands[i];
+            glVertexAttribI4ui(DRAW_ID_LOCATION, firstDrawID + command.baseInstance, 0, 0, 0);
+            glDrawElementsBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+                (void*)(command.firstIndex * sizeof(GLuint)), command.baseVertex);
+        }
+        m_frameCalls += drawCount;
+    }
+
+    m_frameDraws += drawCount;
+    m_commands.clear();
+    m_drawData.clear();
+}
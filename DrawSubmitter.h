@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Matches the command layout glMultiDrawElementsIndirect reads
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Per-draw constants, fetched in the vertex shader from a texture buffer
+// indexed by the draw ID (nine RGBA32F texels per draw)
+struct DrawData {
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::vec4 color = glm::vec4(1.0f);                        // bulb colour or material diffuse
+    glm::vec4 material = glm::vec4(0.5f, 0.5f, 0.5f, 32.0f);  // specular.rgb, shininess
+    glm::vec4 normalMatrix[3];                                // filled in by Submit from model
+};
+
+// Collects draws from one VAO and submits them as a single
+// glMultiDrawElementsIndirect on GL 4.3+, or as back-to-back
+// glDrawElementsBaseVertex calls on a 3.3 context. The draw ID comes from an
+// instanced attribute stepped by baseInstance (MDI) or from the attribute's
+// constant value set before each draw (fallback), so shaders see the same input.
+// Per-draw data and indirect commands are streamed through the renderer's
+// frame ring; the draw data texture spans the whole ring, and draw IDs start
+// at the batch's offset in it.
+class DrawSubmitter {
+public:
+    static const unsigned int DRAW_ID_LOCATION = 7;
+    static const unsigned int DRAW_DATA_TEXTURE_UNIT = 4;
+
+    DrawSubmitter();
+    ~DrawSubmitter();
+
+    DrawSubmitter(const DrawSubmitter&) = delete;
+    DrawSubmitter& operator=(const DrawSubmitter&) = delete;
+
+    // Add the draw ID attribute to a VAO that will be drawn through the submitter
+    void AttachToVertexArray(unsigned int vao);
+
+    // Queue one indexed draw from the currently bound VAO
+    void Add(unsigned int indexCount, unsigned int firstIndex, int baseVertex, const DrawData& data);
+
+    // Upload the queued draws and per-draw data, then issue them
+    void Submit();
+
+    bool UsesMultiDrawIndirect() const { return m_multiDrawIndirect; }
+
+    // Per-frame statistics
+    void ResetStats() { m_frameDraws = 0; m_frameCalls = 0; m_frameIdentityNormals = 0; }
+    int GetDrawCount() const { return m_frameDraws; }
+    int GetCallCount() const { return m_frameCalls; }
+    int GetIdentityNormalCount() const { return m_frameIdentityNormals; } // draws that skipped the inverse
+
+private:
+    bool m_multiDrawIndirect;
+    std::vector<DrawElementsIndirectCommand> m_commands;
+    std::vector<DrawData> m_drawData;
+
+    unsigned int m_drawDataTexture;
+    unsigned int m_drawDataSource; // generation of the ring buffer the texture currently views
+    unsigned int m_drawIdBuffer;
+    unsigned int m_drawIdCapacity;
+
+    int m_frameDraws;
+    int m_frameCalls;
+    int m_frameIdentityNormals;
+
+    void ReserveDrawIds(unsigned int count);
+};
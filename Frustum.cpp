@@ -0,0 +1,394 @@
+#include "Frustum.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FRUSTUM_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_SSE2 1
+#endif
+
+void BoxBounds::Clear() {
+    centerX.clear(); centerY.clear(); centerZ.clear();
+    extentX.clear(); extentY.clear(); extentZ.clear();
+}
+
+void BoxBounds::Reserve(size_t count) {
+    centerX.reserve(count); centerY.reserve(count); centerZ.reserve(count);
+    extentX.reserve(count); extentY.reserve(count); extentZ.reserve(count);
+}
+
+void BoxBounds::Add(const glm::vec3& center, const glm::vec3& extent) {
+    centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+    extentX.push_back(extent.x); extentY.push_back(extent.y); extentZ.push_back(extent.z);
+}
+
+void BoxBounds::Set(size_t index, const glm::vec3& center, const glm::vec3& extent) {
+    centerX[index] = center.x; centerY[index] = center.y; centerZ[index] = center.z;
+    extentX[index] = extent.x; extentY[index] = extent.y; extentZ[index] = extent.z;
+}
+
+void BoxBounds::RemoveSwap(size_t index) {
+    size_t last = Size() - 1;
+    centerX[index] = centerX[last]; centerY[index] = centerY[last]; centerZ[index] = centerZ[last];
+    extentX[index] = extentX[last]; extentY[index] = extentY[last]; extentZ[index] = extentZ[last];
+    centerX.pop_back(); centerY.pop_back(); centerZ.pop_back();
+    extentX.pop_back(); extentY.pop_back(); extentZ.pop_back();
+}
+
+void SphereBounds::Clear() {
+    centerX.clear(); centerY.clear(); centerZ.clear();
+    radius.clear();
+}
+
+void SphereBounds::Reserve(size_t count) {
+    centerX.reserve(count); centerY.reserve(count); centerZ.reserve(count);
+    radius.reserve(count);
+}
+
+void SphereBounds::Add(const glm::vec3& center, float r) {
+    centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+    radius.push_back(r);
+}
+
+void SphereBounds::Set(size_t index, const glm::vec3& center, float r) {
+    centerX[index] = center.x; centerY[index] = center.y; centerZ[index] = center.z;
+    radius[index] = r;
+}
+
+void SphereBounds::Resize(size_t count) {
+    centerX.resize(count); centerY.resize(count); centerZ.resize(count);
+    radius.resize(count);
+}
+
+Frustum::Frustum() {
+    // Until Extract is called every plane accepts everything
+    for (glm::vec4& plane : m_planes) {
+        plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+}
+
+void Frustum::Extract(const glm::mat4& m) {
+    // Gribb/Hartmann: each plane is the fourth row of the matrix plus or minus another row
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    m_planes[0] = row3 + row0; // left
+    m_planes[1] = row3 - row0; // right
+    m_planes[2] = row3 + row1; // bottom
+    m_planes[3] = row3 - row1; // top
+    m_planes[4] = row3 + row2; // near
+    m_planes[5] = row3 - row2; // far
+
+    for (glm::vec4& plane : m_planes) {
+        float length = glm::length(glm::vec3(plane));
+        plane = plane / length;
+    }
+}
+
+bool Frustum::IntersectsBox(const glm::vec3& center, const glm::vec3& extent) const {
+    for (const glm::vec4& plane : m_planes) {
+        // Distance of the box's most positive corner along the plane normal
+        float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+        float reach = glm::dot(glm::abs(glm::vec3(plane)), extent);
+        if (distance + reach < 0.0f) return false;
+    }
+    return true;
+}
+
+FrustumTest Frustum::ClassifyBox(const glm::vec3& center, const glm::vec3& extent) const {
+    FrustumTest result = FrustumTest::Inside;
+    for (const glm::vec4& plane : m_planes) {
+        float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+        float reach = glm::dot(glm::abs(glm::vec3(plane)), extent);
+        if (distance + reach < 0.0f) return FrustumTest::Outside;
+        if (distance - reach < 0.0f) result = FrustumTest::Intersecting;
+    }
+    return result;
+}
+
+bool Frustum::IntersectsSphere(const glm::vec3& center, float radius) const {
+    for (const glm::vec4& plane : m_planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w + radius < 0.0f) return false;
+    }
+    return true;
+}
+
+void Frustum::TransformBox(const glm::mat4& transform, glm::vec3& center, glm::vec3& extent) {
+    glm::vec3 local = extent;
+    center = glm::vec3(transform * glm::vec4(center, 1.0f));
+    for (int row = 0; row < 3; row++) {
+        extent[row] = std::fabs(transform[0][row]) * local.x
+                    + std::fabs(transform[1][row]) * local.y
+                    + std::fabs(transform[2][row]) * local.z;
+    }
+}
+
+const char* Frustum::GetKernelName() {
+#if defined(FRUSTUM_AVX2)
+    return "AVX2";
+#elif defined(FRUSTUM_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+namespace {
+
+// Planes split into components, plus the absolute normals the box test needs
+struct PlaneSet {
+    float nx[6], ny[6], nz[6], d[6];
+    float ax[6], ay[6], az[6];
+
+    explicit PlaneSet(const Frustum& frustum) {
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4& plane = frustum.GetPlane(p);
+            nx[p] = plane.x; ny[p] = plane.y; nz[p] = plane.z; d[p] = plane.w;
+            ax[p] = std::fabs(plane.x); ay[p] = std::fabs(plane.y); az[p] = std::fabs(plane.z);
+        }
+    }
+};
+
+inline bool BoxVisible(const PlaneSet& planes, const BoxBounds& boxes, size_t i) {
+    for (int p = 0; p < 6; p++) {
+        float distance = planes.nx[p] * boxes.centerX[i] + planes.ny[p] * boxes.centerY[i] + planes.nz[p] * boxes.centerZ[i] + planes.d[p];
+        float reach = planes.ax[p] * boxes.extentX[i] + planes.ay[p] * boxes.extentY[i] + planes.az[p] * boxes.extentZ[i];
+        if (distance + reach < 0.0f) return false;
+    }
+    return true;
+}
+
+inline bool SphereVisible(const PlaneSet& planes, const SphereBounds& spheres, size_t i) {
+    for (int p = 0; p < 6; p++) {
+        float distance = planes.nx[p] * spheres.centerX[i] + planes.ny[p] * spheres.centerY[i] + planes.nz[p] * spheres.centerZ[i] + planes.d[p];
+        if (distance + spheres.radius[i] < 0.0f) return false;
+    }
+    return true;
+}
+
+// Branch-free compaction: every lane is written, only visible ones advance the cursor
+inline size_t Compact(uint32_t* out, size_t count, uint32_t base, int mask, int lanes) {
+    for (int lane = 0; lane < lanes; lane++) {
+        out[count] = base + lane;
+        count += (mask >> lane) & 1;
+    }
+    return count;
+}
+
+size_t CullBoxesScalar(const PlaneSet& planes, const BoxBounds& boxes, size_t first, uint32_t* out, size_t count) {
+    for (size_t i = first; i < boxes.Size(); i++) {
+        out[count] = static_cast<uint32_t>(i);
+        count += BoxVisible(planes, boxes, i);
+    }
+    return count;
+}
+
+size_t CullSpheresScalar(const PlaneSet& planes, const SphereBounds& spheres, size_t first, uint32_t* out, size_t count) {
+    for (size_t i = first; i < spheres.Size(); i++) {
+        out[count] = static_cast<uint32_t>(i);
+        count += SphereVisible(planes, spheres, i);
+    }
+    return count;
+}
+
+#if defined(FRUSTUM_AVX2)
+size_t CullBoxesSimd(const PlaneSet& planes, const BoxBounds& boxes, uint32_t* out, size_t& next) {
+    size_t count = 0;
+    size_t total = boxes.Size();
+    const __m256 zero = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 8 <= total; i += 8) {
+        __m256 cx = _mm256_loadu_ps(&boxes.centerX[i]);
+        __m256 cy = _mm256_loadu_ps(&boxes.centerY[i]);
+        __m256 cz = _mm256_loadu_ps(&boxes.centerZ[i]);
+        __m256 ex = _mm256_loadu_ps(&boxes.extentX[i]);
+        __m256 ey = _mm256_loadu_ps(&boxes.extentY[i]);
+        __m256 ez = _mm256_loadu_ps(&boxes.extentZ[i]);
+
+        // Most boxes fall outside one of the first planes, so stop once all lanes have
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(planes.nx[p])), _mm256_mul_ps(cy, _mm256_set1_ps(planes.ny[p]))),
+                _mm256_add_ps(_mm256_mul_ps(cz, _mm256_set1_ps(planes.nz[p])), _mm256_set1_ps(planes.d[p])));
+            __m256 reach = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(planes.ax[p])), _mm256_mul_ps(ey, _mm256_set1_ps(planes.ay[p]))),
+                _mm256_mul_ps(ez, _mm256_set1_ps(planes.az[p])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), zero, _CMP_GE_OQ));
+            if (_mm256_movemask_ps(inside) == 0) break;
+        }
+        count = Compact(out, count, static_cast<uint32_t>(i), _mm256_movemask_ps(inside), 8);
+    }
+    next = i;
+    return count;
+}
+
+size_t CullSpheresSimd(const PlaneSet& planes, const SphereBounds& spheres, uint32_t* out, size_t& next) {
+    size_t count = 0;
+    size_t total = spheres.Size();
+    const __m256 zero = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 8 <= total; i += 8) {
+        __m256 cx = _mm256_loadu_ps(&spheres.centerX[i]);
+        __m256 cy = _mm256_loadu_ps(&spheres.centerY[i]);
+        __m256 cz = _mm256_loadu_ps(&spheres.centerZ[i]);
+        __m256 r = _mm256_loadu_ps(&spheres.radius[i]);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(planes.nx[p])), _mm256_mul_ps(cy, _mm256_set1_ps(planes.ny[p]))),
+                _mm256_add_ps(_mm256_mul_ps(cz, _mm256_set1_ps(planes.nz[p])), _mm256_set1_ps(planes.d[p])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, r), zero, _CMP_GE_OQ));
+            if (_mm256_movemask_ps(inside) == 0) break;
+        }
+        count = Compact(out, count, static_cast<uint32_t>(i), _mm256_movemask_ps(inside), 8);
+    }
+    next = i;
+    return count;
+}
+#elif defined(FRUSTUM_SSE2)
+size_t CullBoxesSimd(const PlaneSet& planes, const BoxBounds& boxes, uint32_t* out, size_t& next) {
+    size_t count = 0;
+    size_t total = boxes.Size();
+    const __m128 zero = _mm_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 4 <= total; i += 4) {
+        __m128 cx = _mm_loadu_ps(&boxes.centerX[i]);
+        __m128 cy = _mm_loadu_ps(&boxes.centerY[i]);
+        __m128 cz = _mm_loadu_ps(&boxes.centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&boxes.extentX[i]);
+        __m128 ey = _mm_loadu_ps(&boxes.extentY[i]);
+        __m128 ez = _mm_loadu_ps(&boxes.extentZ[i]);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(planes.nx[p])), _mm_mul_ps(cy, _mm_set1_ps(planes.ny[p]))),
+                _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(planes.nz[p])), _mm_set1_ps(planes.d[p])));
+            __m128 reach = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(planes.ax[p])), _mm_mul_ps(ey, _mm_set1_ps(planes.ay[p]))),
+                _mm_mul_ps(ez, _mm_set1_ps(planes.az[p])));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), zero));
+            if (_mm_movemask_ps(inside) == 0) break;
+        }
+        count = Compact(out, count, static_cast<uint32_t>(i), _mm_movemask_ps(inside), 4);
+    }
+    next = i;
+    return count;
+}
+
+size_t CullSpheresSimd(const PlaneSet& planes, const SphereBounds& spheres, uint32_t* out, size_t& next) {
+    size_t count = 0;
+    size_t total = spheres.Size();
+    const __m128 zero = _mm_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 4 <= total; i += 4) {
+        __m128 cx = _mm_loadu_ps(&spheres.centerX[i]);
+        __m128 cy = _mm_loadu_ps(&spheres.centerY[i]);
+        __m128 cz = _mm_loadu_ps(&spheres.centerZ[i]);
+        __m128 r = _mm_loadu_ps(&spheres.radius[i]);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(planes.nx[p])), _mm_mul_ps(cy, _mm_set1_ps(planes.ny[p]))),
+                _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(planes.nz[p])), _mm_set1_ps(planes.d[p])));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), zero));
+            if (_mm_movemask_ps(inside) == 0) break;
+        }
+        count = Compact(out, count, static_cast<uint32_t>(i), _mm_movemask_ps(inside), 4);
+    }
+    next = i;
+    return count;
+}
+#else
+size_t CullBoxesSimd(const PlaneSet&, const BoxBounds&, uint32_t*, size_t& next) {
+    next = 0;
+    return 0;
+}
+
+size_t CullSpheresSimd(const PlaneSet&, const SphereBounds&, uint32_t*, size_t& next) {
+    next = 0;
+    return 0;
+}
+#endif
+
+} // namespace
+
+void Frustum::CullBoxes(const BoxBounds& boxes, std::vector<uint32_t>& visible) const {
+    // Room for every index; the kernels write each one and keep the visible ones
+    visible.resize(boxes.Size());
+    if (boxes.Size() == 0) return;
+
+    PlaneSet planes(*this);
+    size_t next = 0;
+    size_t count = CullBoxesSimd(planes, boxes, visible.data(), next);
+    count = CullBoxesScalar(planes, boxes, next, visible.data(), count);
+    visible.resize(count);
+}
+
+void Frustum::CullSpheres(const SphereBounds& spheres, std::vector<uint32_t>& visible) const {
+    visible.resize(spheres.Size());
+    if (spheres.Size() == 0) return;
+
+    PlaneSet planes(*this);
+    size_t next = 0;
+    size_t count = CullSpheresSimd(planes, spheres, visible.data(), next);
+    count = CullSpheresScalar(planes, spheres, next, visible.data(), count);
+    visible.resize(count);
+}
+
+CullBenchmarkResult RunCullBenchmark(int boxCount, int passes) {
+    CullBenchmarkResult result;
+    result.boxCount = boxCount;
+
+    // Boxes scattered around a camera at the origin looking down -Z
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+    std::uniform_real_distribution<float> size(0.25f, 4.0f);
+    BoxBounds boxes;
+    boxes.Reserve(boxCount);
+    for (int i = 0; i < boxCount; i++) {
+        boxes.Add(glm::vec3(position(rng), position(rng), position(rng)), glm::vec3(size(rng), size(rng), size(rng)));
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    Frustum frustum(projection);
+    PlaneSet planes(frustum);
+    std::vector<uint32_t> visible;
+
+    using Clock = std::chrono::high_resolution_clock;
+
+    visible.resize(boxes.Size());
+    auto start = Clock::now();
+    size_t scalarCount = 0;
+    for (int pass = 0; pass < passes; pass++) {
+        scalarCount = CullBoxesScalar(planes, boxes, 0, visible.data(), 0);
+    }
+    result.scalarMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / passes;
+
+    start = Clock::now();
+    for (int pass = 0; pass < passes; pass++) {
+        frustum.CullBoxes(boxes, visible);
+    }
+    result.simdMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / passes;
+
+    result.visibleCount = static_cast<int>(visible.size());
+    if (scalarCount != visible.size()) {
+        result.visibleCount = -1; // kernels disagree
+    }
+    return result;
+}
\ No newline at end of file
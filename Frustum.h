@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Axis-aligned boxes as centre and half extent, one array per component so the
+// culling kernels can load several boxes per instruction
+struct BoxBounds {
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+
+    void Clear();
+    void Reserve(size_t count);
+    void Add(const glm::vec3& center, const glm::vec3& extent);
+    void Set(size_t index, const glm::vec3& center, const glm::vec3& extent);
+    // Move the last box into index and shrink by one
+    void RemoveSwap(size_t index);
+    size_t Size() const { return centerX.size(); }
+};
+
+struct SphereBounds {
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> radius;
+
+    void Clear();
+    void Reserve(size_t count);
+    void Add(const glm::vec3& center, float r);
+    void Set(size_t index, const glm::vec3& center, float r);
+    void Resize(size_t count);
+    size_t Size() const { return centerX.size(); }
+};
+
+enum class FrustumTest {
+    Outside,
+    Intersecting,
+    Inside
+};
+
+// View frustum as six inward-facing planes (xyz = unit normal, w = distance).
+// The batched tests run AVX2 or SSE kernels when the compiler targets them and
+// write a compact list of the indices that survive.
+class Frustum {
+public:
+    Frustum();
+    explicit Frustum(const glm::mat4& viewProjection) { Extract(viewProjection); }
+
+    // Planes of projection * view, in world space
+    void Extract(const glm::mat4& viewProjection);
+
+    bool IntersectsBox(const glm::vec3& center, const glm::vec3& extent) const;
+    bool IntersectsSphere(const glm::vec3& center, float radius) const;
+    // Also tells fully contained boxes apart, so hierarchies can skip testing their children
+    FrustumTest ClassifyBox(const glm::vec3& center, const glm::vec3& extent) const;
+
+    // Replace visible with the indices of the bounds that touch the frustum, in order
+    void CullBoxes(const BoxBounds& boxes, std::vector<uint32_t>& visible) const;
+    void CullSpheres(const SphereBounds& spheres, std::vector<uint32_t>& visible) const;
+
+    const glm::vec4& GetPlane(int index) const { return m_planes[index]; }
+
+    // Box of a local-space AABB after an affine transform
+    static void TransformBox(const glm::mat4& transform, glm::vec3& center, glm::vec3& extent);
+
+    // Widest kernel compiled in: "AVX2", "SSE2" or "scalar"
+    static const char* GetKernelName();
+
+private:
+    glm::vec4 m_planes[6];
+};
+
+struct CullBenchmarkResult {
+    int boxCount = 0;
+    int visibleCount = 0;  // -1 if the kernels disagreed
+    double scalarMs = 0.0; // per pass, plain loop
+    double simdMs = 0.0;   // per pass, CullBoxes
+};
+
+// Cull random boxes against a fixed frustum and time both kernels
+CullBenchmarkResult RunCullBenchmark(int boxCount = 100000, int passes = 50);
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer(GLenum target) : m_target(target), m_tags(), m_oldest(0), m_inFlight(0), m_active(false) {
+    glGenQueries(RING_SIZE, m_queries);
+}
+
+GpuTimer::~GpuTimer() {
+    glDeleteQueries(RING_SIZE, m_queries);
+}
+
+void GpuTimer::Begin(int tag) {
+    m_active = m_inFlight < RING_SIZE;
+    if (!m_active) return;
+
+    int slot = (m_oldest + m_inFlight) % RING_SIZE;
+    m_tags[slot] = tag;
+    glBeginQuery(m_target, m_queries[slot]);
+}
+
+void GpuTimer::End() {
+    if (!m_active) return;
+
+    glEndQuery(m_target);
+    m_inFlight++;
+    m_active = false;
+}
+
+bool GpuTimer::PopResult(GLuint64& elapsed, int& tag) {
+    if (m_inFlight == 0) return false;
+
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(m_queries[m_oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return false;
+
+    glGetQueryObjectui64v(m_queries[m_oldest], GL_QUERY_RESULT, &elapsed);
+    tag = m_tags[m_oldest];
+    m_oldest = (m_oldest + 1) % RING_SIZE;
+    m_inFlight--;
+    return true;
+}
\ No newline at end of file
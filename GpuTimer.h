@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// GL_TIME_ELAPSED timer over a ring of queries. Results are collected a few
+// frames late once the GPU has them, so reading the time never stalls the CPU.
+// If every query is still in flight the frame is simply not timed. Any other
+// single-value query target works the same way, e.g. a pipeline statistic.
+class GpuTimer {
+public:
+    explicit GpuTimer(GLenum target = GL_TIME_ELAPSED);
+    ~GpuTimer();
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    // tag is handed back with the result, e.g. which mode the frame ran in
+    void Begin(int tag = 0);
+    void End();
+
+    // Oldest finished measurement not yet returned, in nanoseconds for a timer
+    bool PopResult(GLuint64& elapsed, int& tag);
+
+private:
+    static const int RING_SIZE = 4;
+
+    GLenum m_target;
+    GLuint m_queries[RING_SIZE];
+    int m_tags[RING_SIZE];
+    int m_oldest;
+    int m_inFlight;
+    bool m_active;
+};
\ No newline at end of file
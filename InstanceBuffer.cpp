@@ -0,0 +1,55 @@
+#include "InstanceBuffer.h"
+#include "Renderer.h"
+#include "RingBuffer.h"
+#include "NormalMatrices.h"
+
+InstanceBuffer::InstanceBuffer() : m_vao(0), m_firstLocation(0), m_normalLocation(0), m_count(0) {
+}
+
+void InstanceBuffer::AttachToVertexArray(unsigned int vao, unsigned int firstLocation, unsigned int normalLocation) {
+    m_vao = vao;
+    m_firstLocation = firstLocation;
+    m_normalLocation = normalLocation;
+
+    // A mat4 attribute occupies four vec4 slots and a mat3 three vec3 slots;
+    // SetTransforms supplies the pointers
+    Renderer::BindVertexArray(vao);
+    for (unsigned int i = 0; i < 4; i++) {
+        glVertexAttribDivisor(firstLocation + i, 1);
+    }
+    for (unsigned int i = 0; i < 3; i++) {
+        glVertexAttribDivisor(normalLocation + i, 1);
+    }
+    Renderer::BindVertexArray(0);
+}
+
+void InstanceBuffer::SetTransforms(const std::vector<glm::mat4>& transforms) {
+    m_count = static_cast<unsigned int>(transforms.size());
+    if (m_count == 0) return;
+
+    m_normals.resize(transforms.size() * 3);
+    NormalMatrices::Compute(transforms.data(), sizeof(glm::mat4), m_normals.data(), 3 * sizeof(glm::vec4), transforms.size());
+
+    // Both writes must land in the same buffer
+    RingBuffer& ring = Renderer::GetFrameRing();
+    size_t transformSize = transforms.size() * sizeof(glm::mat4);
+    size_t normalSize = m_normals.size() * sizeof(glm::vec4);
+    if (!ring.Reserve(transformSize + normalSize + 16)) {
+        m_count = 0;
+        return;
+    }
+    size_t offset = ring.Write(transforms.data(), transformSize);
+    size_t normalOffset = ring.Write(m_normals.data(), normalSize);
+
+    Renderer::BindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, ring.GetID());
+    for (unsigned int i = 0; i < 4; i++) {
+        glVertexAttribPointer(m_firstLocation + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + i * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(m_firstLocation + i);
+    }
+    for (unsigned int i = 0; i < 3; i++) {
+        glVertexAttribPointer(m_normalLocation + i, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(glm::vec4), (void*)(normalOffset + i * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(m_normalLocation + i);
+    }
+    Renderer::BindVertexArray(0);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Per-instance model matrices, read as a mat4 vertex attribute (four
+// consecutive locations) with an attribute divisor of 1, plus their normal
+// matrices as a mat3 attribute (three locations), computed here on the CPU.
+// Both are streamed through the renderer's frame ring, so they are set every
+// frame they are drawn.
+class InstanceBuffer {
+public:
+    InstanceBuffer();
+
+    // Use locations firstLocation..firstLocation+3 for the model matrix and
+    // normalLocation..normalLocation+2 for the normal matrix of the given VAO
+    void AttachToVertexArray(unsigned int vao, unsigned int firstLocation, unsigned int normalLocation);
+
+    // Upload this frame's transforms and point the attached VAO at them
+    void SetTransforms(const std::vector<glm::mat4>& transforms);
+
+    unsigned int GetCount() const { return m_count; }
+
+private:
+    unsigned int m_vao;
+    unsigned int m_firstLocation;
+    unsigned int m_normalLocation;
+    unsigned int m_count;
+    std::vector<glm::vec4> m_normals; // three columns per instance
+};
@@ -0,0 +1,276 @@
+#include "LightClusters.h"
+#include "Lighting.h"
+#include "Frustum.h"
+#include "Renderer.h"
+#include "Shader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CLUSTERS_SSE2 1
+#endif
+
+namespace {
+
+    // ndc in [-1, 1] to a tile in [0, tiles - 1]
+    inline int32_t TileOf(float ndc, float tiles) {
+        float tile = ndc * (0.5f * tiles) + 0.5f * tiles;
+        return static_cast<int32_t>(std::min(std::max(tile, 0.0f), tiles - 1.0f));
+    }
+
+    // Screen span of a sphere along one axis, from its view-space extent
+    // [lo, hi] on that axis and its depth range [depthMin, depthMax]. Each
+    // end is divided by whichever depth pushes it further out, which bounds
+    // the sphere's projection without solving for its tangent planes.
+    inline void TileSpan(float lo, float hi, float depthMin, float depthMax, float projScale, float tiles,
+                         int32_t& tileMin, int32_t& tileMax) {
+        tileMin = TileOf(lo * projScale / (lo < 0.0f ? depthMin : depthMax), tiles);
+        tileMax = TileOf(hi * projScale / (hi > 0.0f ? depthMin : depthMax), tiles);
+    }
+
+#if defined(CLUSTERS_SSE2)
+    inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    inline __m128i TileOf(__m128 ndc, float tiles) {
+        __m128 half = _mm_set1_ps(0.5f * tiles);
+        __m128 tile = _mm_add_ps(_mm_mul_ps(ndc, half), half);
+        tile = _mm_min_ps(_mm_max_ps(tile, _mm_setzero_ps()), _mm_set1_ps(tiles - 1.0f));
+        return _mm_cvttps_epi32(tile);
+    }
+
+    inline void TileSpan(__m128 lo, __m128 hi, __m128 depthMin, __m128 depthMax, float projScale, float tiles,
+                         int32_t* tileMin, int32_t* tileMax) {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 scale = _mm_set1_ps(projScale);
+        __m128 loDepth = Select(_mm_cmplt_ps(lo, zero), depthMin, depthMax);
+        __m128 hiDepth = Select(_mm_cmpgt_ps(hi, zero), depthMin, depthMax);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(tileMin), TileOf(_mm_div_ps(_mm_mul_ps(lo, scale), loDepth), tiles));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(tileMax), TileOf(_mm_div_ps(_mm_mul_ps(hi, scale), hiDepth), tiles));
+    }
+#endif
+
+}
+
+void LightClusters::LightBatch::Resize(size_t count) {
+    x.resize(count); y.resize(count); z.resize(count); radius.resize(count);
+    tileMinX.resize(count); tileMaxX.resize(count); tileMinY.resize(count); tileMaxY.resize(count);
+    depthMin.resize(count); depthMax.resize(count);
+}
+
+LightClusters::LightClusters()
+    : m_blockBuffer(0), m_tableBuffer(0), m_tableTexture(0), m_indexBuffer(0), m_indexTexture(0),
+      m_block(), m_nearPlane(0.0f), m_farPlane(0.0f), m_lightVersion(0), m_valid(false),
+      m_maxClusterLights(0), m_assignMs(0.0)
+{
+    glGenBuffers(1, &m_blockBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_blockBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ClusterBlockData), &m_block, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CLUSTER_BLOCK_BINDING, m_blockBuffer);
+
+    // Every cluster starts empty
+    m_clusterTable.assign(CLUSTER_COUNT * 2, 0);
+
+    glGenBuffers(1, &m_tableBuffer);
+    glGenBuffers(1, &m_indexBuffer);
+    UploadLists();
+
+    glGenTextures(1, &m_tableTexture);
+    Renderer::BindTextureForUpdate(CLUSTER_TABLE_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_tableTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, m_tableBuffer);
+
+    glGenTextures(1, &m_indexTexture);
+    Renderer::BindTextureForUpdate(CLUSTER_LIGHTS_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_indexTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_indexBuffer);
+}
+
+LightClusters::~LightClusters() {
+    glDeleteTextures(1, &m_tableTexture);
+    Renderer::OnTextureDeleted(m_tableTexture);
+    glDeleteTextures(1, &m_indexTexture);
+    Renderer::OnTextureDeleted(m_indexTexture);
+    glDeleteBuffers(1, &m_tableBuffer);
+    glDeleteBuffers(1, &m_indexBuffer);
+    glDeleteBuffers(1, &m_blockBuffer);
+}
+
+const char* LightClusters::GetKernelName() {
+#if defined(CLUSTERS_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+bool LightClusters::UpdateBlock(float nearPlane, float farPlane, int width, int height) {
+    // Slices grow with depth so clusters stay roughly cube-shaped:
+    // slice = log(depth) * scale + bias puts the near plane at 0 and the far plane at SLICES
+    float logRange = std::log(farPlane / nearPlane);
+    ClusterBlockData block;
+    block.grid = glm::ivec4(TILES_X, TILES_Y, SLICES, 0);
+    block.scale = glm::vec4((float)TILES_X / std::max(width, 1), (float)TILES_Y / std::max(height, 1),
+                            SLICES / logRange, -SLICES * std::log(nearPlane) / logRange);
+
+    if (m_valid && block.grid == m_block.grid && block.scale == m_block.scale) return false;
+
+    m_block = block;
+    m_nearPlane = nearPlane;
+    m_farPlane = farPlane;
+    glBindBuffer(GL_UNIFORM_BUFFER, m_blockBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ClusterBlockData), &m_block);
+    return true;
+}
+
+int LightClusters::Slice(float depth) const {
+    int slice = static_cast<int>(std::floor(std::log(depth) * m_block.scale.z + m_block.scale.w));
+    return std::min(std::max(slice, 0), SLICES - 1);
+}
+
+void LightClusters::ProjectLights(const glm::mat4& view, const glm::mat4& projection) {
+    LightBatch& b = m_batch;
+    const size_t count = m_visible.size();
+    const float p00 = projection[0][0], p11 = projection[1][1];
+    const float nearPlane = m_nearPlane;
+
+    size_t i = 0;
+#if defined(CLUSTERS_SSE2)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 nearV = _mm_set1_ps(nearPlane);
+    __m128 m[4][3];
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 3; row++) {
+            m[column][row] = _mm_set1_ps(view[column][row]);
+        }
+    }
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(&b.x[i]);
+        __m128 y = _mm_loadu_ps(&b.y[i]);
+        __m128 z = _mm_loadu_ps(&b.z[i]);
+        __m128 r = _mm_loadu_ps(&b.radius[i]);
+
+        __m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][0]), _mm_mul_ps(y, m[1][0])), _mm_add_ps(_mm_mul_ps(z, m[2][0]), m[3][0]));
+        __m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][1]), _mm_mul_ps(y, m[1][1])), _mm_add_ps(_mm_mul_ps(z, m[2][1]), m[3][1]));
+        __m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][2]), _mm_mul_ps(y, m[1][2])), _mm_add_ps(_mm_mul_ps(z, m[2][2]), m[3][2]));
+
+        // Only the part of the sphere in front of the near plane can be seen
+        __m128 depth = _mm_sub_ps(zero, vz);
+        __m128 depthMin = _mm_max_ps(_mm_sub_ps(depth, r), nearV);
+        __m128 depthMax = _mm_add_ps(depth, r);
+        _mm_storeu_ps(&b.depthMin[i], depthMin);
+        _mm_storeu_ps(&b.depthMax[i], depthMax);
+
+        TileSpan(_mm_sub_ps(vx, r), _mm_add_ps(vx, r), depthMin, depthMax, p00, (float)TILES_X, &b.tileMinX[i], &b.tileMaxX[i]);
+        TileSpan(_mm_sub_ps(vy, r), _mm_add_ps(vy, r), depthMin, depthMax, p11, (float)TILES_Y, &b.tileMinY[i], &b.tileMaxY[i]);
+    }
+#endif
+
+    for (; i < count; i++) {
+        glm::vec3 center = glm::vec3(view * glm::vec4(b.x[i], b.y[i], b.z[i], 1.0f));
+        float r = b.radius[i];
+        float depth = -center.z;
+        b.depthMin[i] = std::max(depth - r, nearPlane);
+        b.depthMax[i] = depth + r;
+
+        TileSpan(center.x - r, center.x + r, b.depthMin[i], b.depthMax[i], p00, (float)TILES_X, b.tileMinX[i], b.tileMaxX[i]);
+        TileSpan(center.y - r, center.y + r, b.depthMin[i], b.depthMax[i], p11, (float)TILES_Y, b.tileMinY[i], b.tileMaxY[i]);
+    }
+}
+
+void LightClusters::BuildLists() {
+    const LightBatch& b = m_batch;
+    const size_t count = m_visible.size();
+
+    // Count, prefix sum, then fill; the count slot doubles as the fill cursor
+    std::fill(m_clusterTable.begin(), m_clusterTable.end(), 0);
+    for (size_t i = 0; i < count; i++) {
+        int sliceMin = Slice(b.depthMin[i]), sliceMax = Slice(b.depthMax[i]);
+        for (int z = sliceMin; z <= sliceMax; z++) {
+            for (int y = b.tileMinY[i]; y <= b.tileMaxY[i]; y++) {
+                for (int x = b.tileMinX[i]; x <= b.tileMaxX[i]; x++) {
+                    m_clusterTable[(x + TILES_X * (y + TILES_Y * z)) * 2 + 1]++;
+                }
+            }
+        }
+    }
+
+    uint32_t offset = 0;
+    m_maxClusterLights = 0;
+    for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+        uint32_t lights = m_clusterTable[cluster * 2 + 1];
+        m_clusterTable[cluster * 2] = offset;
+        m_clusterTable[cluster * 2 + 1] = 0;
+        offset += lights;
+        m_maxClusterLights = std::max(m_maxClusterLights, (int)lights);
+    }
+    m_lightIndices.resize(offset);
+
+    for (size_t i = 0; i < count; i++) {
+        int sliceMin = Slice(b.depthMin[i]), sliceMax = Slice(b.depthMax[i]);
+        for (int z = sliceMin; z <= sliceMax; z++) {
+            for (int y = b.tileMinY[i]; y <= b.tileMaxY[i]; y++) {
+                for (int x = b.tileMinX[i]; x <= b.tileMaxX[i]; x++) {
+                    uint32_t* cluster = &m_clusterTable[(x + TILES_X * (y + TILES_Y * z)) * 2];
+                    m_lightIndices[cluster[0] + cluster[1]++] = m_visible[i];
+                }
+            }
+        }
+    }
+}
+
+void LightClusters::UploadLists() {
+    // Orphaned every rebuild, so the driver never waits on last frame's draws
+    glBindBuffer(GL_TEXTURE_BUFFER, m_tableBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, m_clusterTable.size() * sizeof(uint32_t), m_clusterTable.data(), GL_STREAM_DRAW);
+
+    // A texture buffer needs some storage even when no light is visible
+    glBindBuffer(GL_TEXTURE_BUFFER, m_indexBuffer);
+    if (m_lightIndices.empty()) {
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(uint32_t), nullptr, GL_STREAM_DRAW);
+    }
+    else {
+        glBufferData(GL_TEXTURE_BUFFER, m_lightIndices.size() * sizeof(uint32_t), m_lightIndices.data(), GL_STREAM_DRAW);
+    }
+}
+
+void LightClusters::Update(const Lighting& lighting, const glm::mat4& view, const glm::mat4& projection,
+                           float nearPlane, float farPlane, int width, int height) {
+    Renderer::BindTexture(Lighting::POINT_LIGHT_TEXTURE_UNIT, GL_TEXTURE_BUFFER, lighting.GetPointLightTexture());
+    Renderer::BindTexture(CLUSTER_LIGHTS_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_indexTexture);
+    Renderer::BindTexture(CLUSTER_TABLE_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_tableTexture);
+
+    bool blockChanged = UpdateBlock(nearPlane, farPlane, width, height);
+    if (!blockChanged && m_valid && view == m_view && projection == m_projection &&
+        lighting.GetPointLightVersion() == m_lightVersion) {
+        m_assignMs = 0.0;
+        return;
+    }
+    m_view = view;
+    m_projection = projection;
+    m_lightVersion = lighting.GetPointLightVersion();
+    m_valid = true;
+
+    using Clock = std::chrono::high_resolution_clock;
+    auto start = Clock::now();
+
+    const SphereBounds& lights = lighting.GetPointLightBounds();
+    Frustum(projection * view).CullSpheres(lights, m_visible);
+
+    m_batch.Resize(m_visible.size());
+    for (size_t i = 0; i < m_visible.size(); i++) {
+        uint32_t light = m_visible[i];
+        m_batch.x[i] = lights.centerX[light];
+        m_batch.y[i] = lights.centerY[light];
+        m_batch.z[i] = lights.centerZ[light];
+        m_batch.radius[i] = lights.radius[light];
+    }
+
+    ProjectLights(view, projection);
+    BuildLists();
+    m_assignMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    UploadLists();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+class Lighting;
+
+// std140 layout of the ClusterBlock uniform block
+struct ClusterBlockData {
+    glm::ivec4 grid;  // tiles x, tiles y, depth slices
+    glm::vec4 scale;  // tiles per pixel x and y, slice scale, slice bias
+};
+
+// Clustered forward shading. The view frustum is cut into TILES_X x TILES_Y
+// screen tiles and SLICES depth slices spaced exponentially between the near
+// and far planes; Update hands each cluster the list of point lights whose
+// sphere may reach it, and the fragment shader walks only its own cluster's
+// list. Assignment runs on the CPU: lights are frustum culled, then moved to
+// view space and projected to conservative tile ranges four at a time.
+//
+// Shaders read the cluster table (offset and count per cluster, RG32UI) and
+// the light index list (R32UI) from texture buffers, plus Lighting's point
+// light texture buffer for the lights themselves.
+class LightClusters {
+public:
+    static const int TILES_X = 16;
+    static const int TILES_Y = 9;
+    static const int SLICES = 24;
+    static const int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+    static const unsigned int CLUSTER_LIGHTS_TEXTURE_UNIT = 6;
+    static const unsigned int CLUSTER_TABLE_TEXTURE_UNIT = 7;
+
+    LightClusters();
+    ~LightClusters();
+
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    // Reassign the lights for this view and bind everything the shaders read.
+    // The projection must be a symmetric perspective with the given planes;
+    // width and height are the framebuffer size in pixels. Nothing is rebuilt
+    // while the view, the projection and the lights stay the same.
+    void Update(const Lighting& lighting, const glm::mat4& view, const glm::mat4& projection,
+                float nearPlane, float farPlane, int width, int height);
+
+    // Statistics of the last rebuild
+    int GetVisibleLightCount() const { return static_cast<int>(m_visible.size()); }
+    int GetReferenceCount() const { return static_cast<int>(m_lightIndices.size()); }
+    int GetMaxClusterLights() const { return m_maxClusterLights; }
+    double GetAssignMs() const { return m_assignMs; }
+    static const char* GetKernelName();
+
+private:
+    unsigned int m_blockBuffer;
+    unsigned int m_tableBuffer, m_tableTexture;
+    unsigned int m_indexBuffer, m_indexTexture;
+
+    ClusterBlockData m_block;
+    float m_nearPlane, m_farPlane;
+    glm::mat4 m_view, m_projection;
+    uint32_t m_lightVersion;
+    bool m_valid;
+
+    // Per visible light: world-space sphere in, tile range and depth range out
+    struct LightBatch {
+        std::vector<float> x, y, z, radius;
+        std::vector<int32_t> tileMinX, tileMaxX, tileMinY, tileMaxY;
+        std::vector<float> depthMin, depthMax;
+
+        void Resize(size_t count);
+    };
+
+    std::vector<uint32_t> m_visible;
+    LightBatch m_batch;
+    std::vector<uint32_t> m_clusterTable; // offset, count per cluster
+    std::vector<uint32_t> m_lightIndices;
+    int m_maxClusterLights;
+    double m_assignMs;
+
+    bool UpdateBlock(float nearPlane, float farPlane, int width, int height);
+    void ProjectLights(const glm::mat4& view, const glm::mat4& projection);
+    int Slice(float depth) const;
+    void BuildLists();
+    void UploadLists();
+};
@@ -1,114 +1,165 @@
 #include "Lighting.h"
-#include <string>
-
-Lighting::Lighting() {
-    // Initialize point light positions
-    m_pointLightPositions[0] = glm::vec3(0.7f, 4.2f, 2.0f);
-    m_pointLightPositions[1] = glm::vec3(2.3f, 5.3f, -4.0f);
-    m_pointLightPositions[2] = glm::vec3(-4.0f, 5.0f, -12.0f);
-    m_pointLightPositions[3] = glm::vec3(0.0f, 3.0f, -3.0f);
-
-    // Initialize point light colors
-    m_pointLightColors[0] = glm::vec3(1.0f, 0.6f, 0.0f);  // Orange
-    m_pointLightColors[1] = glm::vec3(1.0f, 0.0f, 0.0f);  // Red
-    m_pointLightColors[2] = glm::vec3(1.0f, 1.0f, 0.0f);  // Yellow
-    m_pointLightColors[3] = glm::vec3(0.2f, 0.2f, 1.0f);  // Blue
+#include "Renderer.h"
+#include "Shader.h"
+#include <algorithm>
+#include <cstddef>
+
+namespace {
+
+    // Position and radius, then colour
+    const size_t POINT_LIGHT_TEXELS = 2;
+
+    // Far enough that the bulbs' 1 / (1 + 0.09d + 0.032d^2) falloff has faded out
+    const float BULB_RADIUS = 25.0f;
+
 }
 
-MultipleLightUniforms Lighting::InitializeUniforms(unsigned int shaderProgram) {
-    MultipleLightUniforms uniforms;
-
-    uniforms.u_model = glGetUniformLocation(shaderProgram, "u_model");
-    uniforms.u_view = glGetUniformLocation(shaderProgram, "u_view");
-    uniforms.u_proj = glGetUniformLocation(shaderProgram, "u_proj");
-
-    // Material uniforms
-    uniforms.materialDiffuse = glGetUniformLocation(shaderProgram, "material.diffuse");
-    uniforms.materialSpecular = glGetUniformLocation(shaderProgram, "material.specular");
-    uniforms.materialShininess = glGetUniformLocation(shaderProgram, "material.shininess");
-
-    // View position
-    uniforms.viewPos = glGetUniformLocation(shaderProgram, "viewPos");
-
-    // Directional light
-    uniforms.dirLightDirection = glGetUniformLocation(shaderProgram, "dirLight.direction");
-    uniforms.dirLightAmbient = glGetUniformLocation(shaderProgram, "dirLight.ambient");
-    uniforms.dirLightDiffuse = glGetUniformLocation(shaderProgram, "dirLight.diffuse");
-    uniforms.dirLightSpecular = glGetUniformLocation(shaderProgram, "dirLight.specular");
-
-    // Point lights (array indexing)
-    for (int i = 0; i < 4; i++) {
-        std::string number = std::to_string(i);
-        uniforms.pointLightPosition[i] = glGetUniformLocation(shaderProgram, ("pointLights[" + number + "].position").c_str());
-        uniforms.pointLightConstant[i] = glGetUniformLocation(shaderProgram, ("pointLights[" + number + "].constant").c_str());
-        uniforms.pointLightLinear[i] = glGetUniformLocation(shaderProgram, ("pointLights[" + number + "].linear").c_str());
-        uniforms.pointLightQuadratic[i] = glGetUniformLocation(shaderProgram, ("pointLights[" + number + "].quadratic").c_str());
-        uniforms.pointLightAmbient[i] = glGetUniformLocation(shaderProgram, ("pointLights[" + number + "].ambient").c_str());
-        uniforms.pointLightDiffuse[i] = glGetUniformLocation(shaderProgram, ("pointLights[" + number + "].diffuse").c_str());
-        uniforms.pointLightSpecular[i] = glGetUniformLocation(shaderProgram, ("pointLights[" + number + "].specular").c_str());
-    }
+Lighting::Lighting()
+    : m_buffer(0), m_data(), m_dirty(~0u), m_uploadedBytes(0),
+      m_anyPointLightDirty(false), m_pointLightVersion(0),
+      m_pointLightBuffer(0), m_pointLightTexture(0), m_pointLightCapacity(0)
+{
+    // Point lights the demo draws bulbs for
+    AddPointLight(glm::vec3(0.7f, 4.2f, 2.0f), glm::vec3(1.0f, 0.6f, 0.0f), BULB_RADIUS);   // Orange
+    AddPointLight(glm::vec3(2.3f, 5.3f, -4.0f), glm::vec3(1.0f, 0.0f, 0.0f), BULB_RADIUS);  // Red
+    AddPointLight(glm::vec3(-4.0f, 5.0f, -12.0f), glm::vec3(1.0f, 1.0f, 0.0f), BULB_RADIUS); // Yellow
+    AddPointLight(glm::vec3(0.0f, 3.0f, -3.0f), glm::vec3(0.2f, 0.2f, 1.0f), BULB_RADIUS);  // Blue
+
+    // Directional light (sun-like light from above)
+    m_data.dirLight.direction = glm::vec4(-0.2f, -1.0f, -0.3f, 0.0f);
+    m_data.dirLight.ambient = glm::vec4(0.05f, 0.05f, 0.05f, 0.0f);
+    m_data.dirLight.diffuse = glm::vec4(0.4f, 0.4f, 0.4f, 0.0f);
+    m_data.dirLight.specular = glm::vec4(0.5f, 0.5f, 0.5f, 0.0f);
+
+    // Spotlight (flashlight attached to camera)
+    m_data.spotLight.attenuation = glm::vec4(1.0f, 0.09f, 0.032f, 0.0f);
+    m_data.spotLight.cutOff = glm::vec4(glm::cos(glm::radians(12.5f)), glm::cos(glm::radians(15.0f)), 0.0f, 0.0f);
+    m_data.spotLight.ambient = glm::vec4(0.0f);
+    m_data.spotLight.diffuse = glm::vec4(1.0f);
+    m_data.spotLight.specular = glm::vec4(1.0f);
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlockData), &m_data, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, m_buffer);
+    m_dirty = 0;
+
+    glGenBuffers(1, &m_pointLightBuffer);
+    glGenTextures(1, &m_pointLightTexture);
+}
 
-    // Spotlight
-    uniforms.spotLightPosition = glGetUniformLocation(shaderProgram, "spotLight.position");
-    uniforms.spotLightDirection = glGetUniformLocation(shaderProgram, "spotLight.direction");
-    uniforms.spotLightCutOff = glGetUniformLocation(shaderProgram, "spotLight.cutOff");
-    uniforms.spotLightOuterCutOff = glGetUniformLocation(shaderProgram, "spotLight.outerCutOff");
-    uniforms.spotLightConstant = glGetUniformLocation(shaderProgram, "spotLight.constant");
-    uniforms.spotLightLinear = glGetUniformLocation(shaderProgram, "spotLight.linear");
-    uniforms.spotLightQuadratic = glGetUniformLocation(shaderProgram, "spotLight.quadratic");
-    uniforms.spotLightAmbient = glGetUniformLocation(shaderProgram, "spotLight.ambient");
-    uniforms.spotLightDiffuse = glGetUniformLocation(shaderProgram, "spotLight.diffuse");
-    uniforms.spotLightSpecular = glGetUniformLocation(shaderProgram, "spotLight.specular");
-
-    return uniforms;
+Lighting::~Lighting() {
+    glDeleteTextures(1, &m_pointLightTexture);
+    Renderer::OnTextureDeleted(m_pointLightTexture);
+    glDeleteBuffers(1, &m_pointLightBuffer);
+    glDeleteBuffers(1, &m_buffer);
 }
 
-void Lighting::SetLightUniforms(const MultipleLightUniforms& uniforms,
-                               const glm::vec3& cameraPos,
-                               const glm::vec3& cameraFront) {
-    // Material properties
-    glUniform1i(uniforms.materialDiffuse, 0);
-    glUniform1i(uniforms.materialSpecular, 1);
-    glUniform1f(uniforms.materialShininess, 32.0f);
+int Lighting::AddPointLight(const glm::vec3& position, const glm::vec3& color, float radius) {
+    int index = GetPointLightCount();
+    m_pointLightBounds.Add(position, radius);
+    m_pointLightColors.push_back(color);
+    m_pointLightTexels.resize(m_pointLightTexels.size() + POINT_LIGHT_TEXELS);
+    m_pointLightDirty.push_back(0);
+    SetPointLight(index, position, color, radius);
+    return index;
+}
 
-    // View position
-    glUniform3fv(uniforms.viewPos, 1, glm::value_ptr(cameraPos));
+void Lighting::SetPointLight(int index, const glm::vec3& position, const glm::vec3& color, float radius) {
+    m_pointLightBounds.Set(index, position, radius);
+    m_pointLightColors[index] = color;
 
-    // Directional light (sun-like light from above)
-    glUniform3f(uniforms.dirLightDirection, -0.2f, -1.0f, -0.3f);
-    glUniform3f(uniforms.dirLightAmbient, 0.05f, 0.05f, 0.05f);
-    glUniform3f(uniforms.dirLightDiffuse, 0.4f, 0.4f, 0.4f);
-    glUniform3f(uniforms.dirLightSpecular, 0.5f, 0.5f, 0.5f);
-
-    // Point lights
-    for (int i = 0; i < 4; i++) {
-        glUniform3fv(uniforms.pointLightPosition[i], 1, glm::value_ptr(m_pointLightPositions[i]));
-        glUniform1f(uniforms.pointLightConstant[i], 1.0f);
-        glUniform1f(uniforms.pointLightLinear[i], 0.09f);
-        glUniform1f(uniforms.pointLightQuadratic[i], 0.032f);
-
-        // Use different colors for variety
-        glm::vec3 color = m_pointLightColors[i];
-        glUniform3f(uniforms.pointLightAmbient[i], color.x * 0.1f, color.y * 0.1f, color.z * 0.1f);
-        glUniform3f(uniforms.pointLightDiffuse[i], color.x, color.y, color.z);
-        glUniform3f(uniforms.pointLightSpecular[i], 1.0f, 1.0f, 1.0f);
+    glm::vec4* texels = &m_pointLightTexels[index * POINT_LIGHT_TEXELS];
+    texels[0] = glm::vec4(position, radius);
+    texels[1] = glm::vec4(color, 0.0f);
+    m_pointLightDirty[index] = 1;
+    m_anyPointLightDirty = true;
+    m_pointLightVersion++;
+}
+
+void Lighting::SetPointLightCount(int count) {
+    if (count >= GetPointLightCount()) return;
+    m_pointLightBounds.Resize(count);
+    m_pointLightColors.resize(count);
+    m_pointLightTexels.resize(count * POINT_LIGHT_TEXELS);
+    m_pointLightDirty.resize(count);
+    m_pointLightVersion++;
+}
+
+glm::vec3 Lighting::GetPointLightPosition(int index) const {
+    return glm::vec3(m_pointLightBounds.centerX[index], m_pointLightBounds.centerY[index], m_pointLightBounds.centerZ[index]);
+}
+
+void Lighting::SetSpotlight(const glm::vec3& position, const glm::vec3& direction) {
+    glm::vec4 newPosition(position, 1.0f);
+    glm::vec4 newDirection(direction, 0.0f);
+    if (newPosition == m_data.spotLight.position && newDirection == m_data.spotLight.direction) return;
+
+    m_data.spotLight.position = newPosition;
+    m_data.spotLight.direction = newDirection;
+    m_dirty |= SPOT_LIGHT_BIT;
+}
+
+void Lighting::UpdateSpotlightCutoff(float innerCutoff, float outerCutoff) {
+    m_data.spotLight.cutOff = glm::vec4(glm::cos(glm::radians(innerCutoff)), glm::cos(glm::radians(outerCutoff)), 0.0f, 0.0f);
+    m_dirty |= SPOT_LIGHT_BIT;
+}
+
+void Lighting::UploadRange(const void* member, size_t size) {
+    size_t offset = static_cast<const unsigned char*>(member) - reinterpret_cast<const unsigned char*>(&m_data);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, member);
+    m_uploadedBytes += static_cast<int>(size);
+}
+
+void Lighting::UploadPointLights() {
+    const size_t texelSize = POINT_LIGHT_TEXELS * sizeof(glm::vec4);
+    size_t count = m_pointLightDirty.size();
+    glBindBuffer(GL_TEXTURE_BUFFER, m_pointLightBuffer);
+
+    // Growing respecifies the whole store; the texture keeps pointing at the buffer
+    if (count > m_pointLightCapacity) {
+        m_pointLightCapacity = std::max(count, m_pointLightCapacity * 2);
+        glBufferData(GL_TEXTURE_BUFFER, m_pointLightCapacity * texelSize, nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, count * texelSize, m_pointLightTexels.data());
+        m_uploadedBytes += static_cast<int>(count * texelSize);
+        std::fill(m_pointLightDirty.begin(), m_pointLightDirty.end(), 0);
+
+        Renderer::BindTextureForUpdate(POINT_LIGHT_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_pointLightTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_pointLightBuffer);
+        return;
     }
 
-    // Spotlight (flashlight attached to camera)
-    glUniform3fv(uniforms.spotLightPosition, 1, glm::value_ptr(cameraPos));
-    glUniform3fv(uniforms.spotLightDirection, 1, glm::value_ptr(cameraFront));
-    glUniform1f(uniforms.spotLightCutOff, glm::cos(glm::radians(12.5f)));
-    glUniform1f(uniforms.spotLightOuterCutOff, glm::cos(glm::radians(15.0f)));
-    glUniform1f(uniforms.spotLightConstant, 1.0f);
-    glUniform1f(uniforms.spotLightLinear, 0.09f);
-    glUniform1f(uniforms.spotLightQuadratic, 0.032f);
-    glUniform3f(uniforms.spotLightAmbient, 0.0f, 0.0f, 0.0f);
-    glUniform3f(uniforms.spotLightDiffuse, 1.0f, 1.0f, 1.0f);
-    glUniform3f(uniforms.spotLightSpecular, 1.0f, 1.0f, 1.0f);
+    // One call per run of neighbouring dirty lights
+    size_t i = 0;
+    while (i < count) {
+        if (!m_pointLightDirty[i]) {
+            i++;
+            continue;
+        }
+        size_t first = i;
+        while (i < count && m_pointLightDirty[i]) {
+            m_pointLightDirty[i++] = 0;
+        }
+        size_t size = (i - first) * texelSize;
+        glBufferSubData(GL_TEXTURE_BUFFER, first * texelSize, size, &m_pointLightTexels[first * POINT_LIGHT_TEXELS]);
+        m_uploadedBytes += static_cast<int>(size);
+    }
 }
 
-void Lighting::UpdateSpotlightCutoff(unsigned int shaderProgram, float innerCutoff, float outerCutoff) {
-    glUseProgram(shaderProgram);
-    glUniform1f(glGetUniformLocation(shaderProgram, "spotLight.cutOff"), glm::cos(glm::radians(innerCutoff)));
-    glUniform1f(glGetUniformLocation(shaderProgram, "spotLight.outerCutOff"), glm::cos(glm::radians(outerCutoff)));
-}
\ No newline at end of file
+void Lighting::Upload() {
+    m_uploadedBytes = 0;
+    if (m_anyPointLightDirty) {
+        UploadPointLights();
+        m_anyPointLightDirty = false;
+    }
+    if (m_dirty == 0) return;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    if (m_dirty & DIR_LIGHT_BIT) {
+        UploadRange(&m_data.dirLight, sizeof(GpuDirLight));
+    }
+    if (m_dirty & SPOT_LIGHT_BIT) {
+        UploadRange(&m_data.spotLight, sizeof(GpuSpotLight));
+    }
+    m_dirty = 0;
+}
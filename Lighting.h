@@ -3,64 +3,96 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "Frustum.h"
+#include <cstdint>
+#include <vector>
 
-struct MultipleLightUniforms {
-    GLint u_model;
-    GLint u_view;
-    GLint u_proj;
-
-    // Material
-    GLint materialDiffuse;
-    GLint materialSpecular;
-    GLint materialShininess;
-
-    // View position
-    GLint viewPos;
-
-    // Directional light
-    GLint dirLightDirection;
-    GLint dirLightAmbient;
-    GLint dirLightDiffuse;
-    GLint dirLightSpecular;
-
-    // Point lights array
-    GLint pointLightPosition[4];
-    GLint pointLightConstant[4];
-    GLint pointLightLinear[4];
-    GLint pointLightQuadratic[4];
-    GLint pointLightAmbient[4];
-    GLint pointLightDiffuse[4];
-    GLint pointLightSpecular[4];
-
-    // Spotlight
-    GLint spotLightPosition;
-    GLint spotLightDirection;
-    GLint spotLightCutOff;
-    GLint spotLightOuterCutOff;
-    GLint spotLightConstant;
-    GLint spotLightLinear;
-    GLint spotLightQuadratic;
-    GLint spotLightAmbient;
-    GLint spotLightDiffuse;
-    GLint spotLightSpecular;
+// std140 layouts of the lights in LightBlock; every member is padded to a vec4
+struct GpuDirLight {
+    glm::vec4 direction;
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
 };
 
+struct GpuSpotLight {
+    glm::vec4 position;
+    glm::vec4 direction;
+    glm::vec4 attenuation; // constant, linear, quadratic
+    glm::vec4 cutOff;      // cos inner, cos outer
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+};
+
+struct LightBlockData {
+    GpuDirLight dirLight;
+    GpuSpotLight spotLight;
+};
+
+// Retained light state. The directional light and spotlight live in a uniform
+// buffer bound at LIGHT_BLOCK_BINDING; point lights are a runtime list in a
+// texture buffer (two RGBA32F texels per light: position and radius, colour)
+// that LightClusters assigns to screen clusters. Setters only mark the light
+// they change; Upload sends the dirty lights and nothing else, so a frame with
+// static lights uploads nothing.
 class Lighting {
 public:
+    static const unsigned int POINT_LIGHT_TEXTURE_UNIT = 5;
+
     Lighting();
-    
-    MultipleLightUniforms InitializeUniforms(unsigned int shaderProgram);
-    void SetLightUniforms(const MultipleLightUniforms& uniforms,
-                         const glm::vec3& cameraPos,
-                         const glm::vec3& cameraFront);
-    
-    void UpdateSpotlightCutoff(unsigned int shaderProgram, float innerCutoff, float outerCutoff);
-    
+    ~Lighting();
+
+    Lighting(const Lighting&) = delete;
+    Lighting& operator=(const Lighting&) = delete;
+
+    // Point lights stop lighting anything past radius. The constructor adds
+    // the four lights the demo draws bulbs for.
+    int AddPointLight(const glm::vec3& position, const glm::vec3& color, float radius);
+    void SetPointLight(int index, const glm::vec3& position, const glm::vec3& color, float radius);
+    // Drop every light from count on
+    void SetPointLightCount(int count);
+
+    // The spotlight is a flashlight held by the camera
+    void SetSpotlight(const glm::vec3& position, const glm::vec3& direction);
+    void UpdateSpotlightCutoff(float innerCutoff, float outerCutoff);
+
+    // Send the lights changed since the last upload
+    void Upload();
+
     // Getters
-    const glm::vec3* GetPointLightPositions() const { return m_pointLightPositions; }
-    const glm::vec3* GetPointLightColors() const { return m_pointLightColors; }
+    int GetPointLightCount() const { return static_cast<int>(m_pointLightColors.size()); }
+    glm::vec3 GetPointLightPosition(int index) const;
+    const glm::vec3& GetPointLightColor(int index) const { return m_pointLightColors[index]; }
+    const SphereBounds& GetPointLightBounds() const { return m_pointLightBounds; }
+    unsigned int GetPointLightTexture() const { return m_pointLightTexture; }
+    // Bumped by every point light change
+    uint32_t GetPointLightVersion() const { return m_pointLightVersion; }
+
+    // Bytes sent by the last Upload
+    int GetUploadedBytes() const { return m_uploadedBytes; }
 
 private:
-    glm::vec3 m_pointLightPositions[4];
-    glm::vec3 m_pointLightColors[4];
-};
\ No newline at end of file
+    // One dirty bit per light
+    static const uint32_t DIR_LIGHT_BIT = 1u << 0;
+    static const uint32_t SPOT_LIGHT_BIT = 1u << 1;
+
+    unsigned int m_buffer;
+    LightBlockData m_data;
+    uint32_t m_dirty;
+    int m_uploadedBytes;
+
+    SphereBounds m_pointLightBounds;
+    std::vector<glm::vec3> m_pointLightColors;
+    std::vector<glm::vec4> m_pointLightTexels;
+    std::vector<uint8_t> m_pointLightDirty;
+    bool m_anyPointLightDirty;
+    uint32_t m_pointLightVersion;
+
+    unsigned int m_pointLightBuffer;
+    unsigned int m_pointLightTexture;
+    size_t m_pointLightCapacity; // lights the texture buffer has room for
+
+    void UploadRange(const void* member, size_t size);
+    void UploadPointLights();
+};
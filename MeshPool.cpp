@@ -0,0 +1,138 @@
+#include "MeshPool.h"
+#include "Renderer.h"
+#include <algorithm>
+
+bool MeshPool::RangeAllocator::Allocate(unsigned int size, unsigned int& offset) {
+    for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it) {
+        if (it->size < size) continue;
+
+        offset = it->offset;
+        it->offset += size;
+        it->size -= size;
+        if (it->size == 0) {
+            freeBlocks.erase(it);
+        }
+        return true;
+    }
+    return false;
+}
+
+void MeshPool::RangeAllocator::Free(unsigned int offset, unsigned int size) {
+    if (size == 0) return;
+
+    auto next = std::lower_bound(freeBlocks.begin(), freeBlocks.end(), offset,
+        [](const Block& block, unsigned int value) { return block.offset < value; });
+    auto it = freeBlocks.insert(next, { offset, size });
+
+    // Coalesce with the following and preceding blocks
+    auto after = it + 1;
+    if (after != freeBlocks.end() && it->offset + it->size == after->offset) {
+        it->size += after->size;
+        freeBlocks.erase(after);
+    }
+    if (it != freeBlocks.begin()) {
+        auto before = it - 1;
+        if (before->offset + before->size == it->offset) {
+            before->size += it->size;
+            freeBlocks.erase(it);
+        }
+    }
+}
+
+void MeshPool::RangeAllocator::Grow(unsigned int newCapacity) {
+    unsigned int oldCapacity = capacity;
+    capacity = newCapacity;
+    Free(oldCapacity, newCapacity - oldCapacity);
+}
+
+MeshPool::MeshPool(unsigned int initialVertices, unsigned int initialIndices)
+    : m_VAO(0), m_VBO(0), m_EBO(0)
+{
+    glGenVertexArrays(1, &m_VAO);
+    glGenBuffers(1, &m_VBO);
+    glGenBuffers(1, &m_EBO);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_VBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, (size_t)initialVertices * VERTEX_STRIDE, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_EBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, (size_t)initialIndices * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW);
+
+    m_vertices.Grow(initialVertices);
+    m_indices.Grow(initialIndices);
+
+    SetupVertexArray();
+}
+
+MeshPool::~MeshPool() {
+    glDeleteVertexArrays(1, &m_VAO);
+    Renderer::OnVertexArrayDeleted(m_VAO);
+    glDeleteBuffers(1, &m_VBO);
+    glDeleteBuffers(1, &m_EBO);
+}
+
+MeshRange MeshPool::Allocate(const std::vector<float>& vertices, const std::vector<unsigned int>& indices) {
+    MeshRange range;
+    if (vertices.empty() || indices.empty()) return range;
+
+    range.vertexCount = static_cast<unsigned int>(vertices.size() / 8);
+    range.indexCount = static_cast<unsigned int>(indices.size());
+
+    while (!m_vertices.Allocate(range.vertexCount, range.firstVertex)) {
+        unsigned int newCapacity = std::max(m_vertices.capacity * 2, m_vertices.capacity + range.vertexCount);
+        GrowBuffer(m_VBO, (size_t)m_vertices.capacity * VERTEX_STRIDE, (size_t)newCapacity * VERTEX_STRIDE);
+        m_vertices.Grow(newCapacity);
+    }
+    while (!m_indices.Allocate(range.indexCount, range.firstIndex)) {
+        unsigned int newCapacity = std::max(m_indices.capacity * 2, m_indices.capacity + range.indexCount);
+        GrowBuffer(m_EBO, (size_t)m_indices.capacity * sizeof(unsigned int), (size_t)newCapacity * sizeof(unsigned int));
+        m_indices.Grow(newCapacity);
+    }
+
+    // Upload through the copy target so no VAO's element binding is touched
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_VBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)range.firstVertex * VERTEX_STRIDE, vertices.size() * sizeof(float), vertices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)range.firstIndex * sizeof(unsigned int), indices.size() * sizeof(unsigned int), indices.data());
+
+    return range;
+}
+
+void MeshPool::Free(const MeshRange& range) {
+    if (!range.IsValid()) return;
+
+    m_vertices.Free(range.firstVertex, range.vertexCount);
+    m_indices.Free(range.firstIndex, range.indexCount);
+}
+
+void MeshPool::GrowBuffer(unsigned int& buffer, size_t oldSize, size_t newSize) {
+    unsigned int grown;
+    glGenBuffers(1, &grown);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+
+    glDeleteBuffers(1, &buffer);
+    buffer = grown;
+
+    SetupVertexArray();
+}
+
+void MeshPool::SetupVertexArray() {
+    Renderer::BindVertexArray(m_VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    // layout: pos(3), normal(3), uv(2)
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_STRIDE, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_STRIDE, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, VERTEX_STRIDE, (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+    Renderer::BindVertexArray(0);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+
+// Location of a mesh inside a MeshPool, in vertices/indices
+struct MeshRange {
+    unsigned int firstVertex = 0;
+    unsigned int vertexCount = 0;
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+
+    bool IsValid() const { return indexCount > 0; }
+};
+
+// One VAO with a shared vertex and index buffer that many meshes are
+// sub-allocated from, so they can be drawn with base-vertex / indirect draws
+// without rebinding anything. Vertex layout: pos(3), normal(3), uv(2).
+// Indices are relative to the mesh's first vertex.
+class MeshPool {
+public:
+    MeshPool(unsigned int initialVertices = 1 << 16, unsigned int initialIndices = 1 << 17);
+    ~MeshPool();
+
+    MeshPool(const MeshPool&) = delete;
+    MeshPool& operator=(const MeshPool&) = delete;
+
+    MeshRange Allocate(const std::vector<float>& vertices, const std::vector<unsigned int>& indices);
+    void Free(const MeshRange& range);
+
+    unsigned int GetVAO() const { return m_VAO; }
+    unsigned int GetVertexCapacity() const { return m_vertices.capacity; }
+    unsigned int GetIndexCapacity() const { return m_indices.capacity; }
+
+    static const unsigned int VERTEX_STRIDE = 8 * sizeof(float);
+
+private:
+    // First-fit free list over a range of elements
+    struct RangeAllocator {
+        struct Block { unsigned int offset, size; };
+        std::vector<Block> freeBlocks; // sorted by offset, never adjacent
+        unsigned int capacity = 0;
+
+        bool Allocate(unsigned int size, unsigned int& offset);
+        void Free(unsigned int offset, unsigned int size);
+        void Grow(unsigned int newCapacity);
+    };
+
+    unsigned int m_VAO, m_VBO, m_EBO;
+    RangeAllocator m_vertices;
+    RangeAllocator m_indices;
+
+    void GrowBuffer(unsigned int& buffer, size_t oldSize, size_t newSize);
+    void SetupVertexArray();
+};
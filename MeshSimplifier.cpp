@@ -0,0 +1,256 @@
+#include "MeshSimplifier.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+    const size_t VERTEX_FLOATS = 8;
+
+    // Edges used by a single triangle get a perpendicular plane this much
+    // heavier than a face, so open borders keep their shape
+    const double BOUNDARY_WEIGHT = 10.0;
+
+    // Each pass collapses at most this fraction of its candidate edges before
+    // the costs are recomputed
+    const size_t PASS_FRACTION = 8;
+
+    // Symmetric 4x4 error matrix plus the face area it was built from
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+        double a11 = 0, a12 = 0, a13 = 0;
+        double a22 = 0, a23 = 0;
+        double a33 = 0;
+        double weight = 0;
+
+        void AddPlane(const glm::vec3& n, float d, double w) {
+            a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+            a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+            a22 += w * n.z * n.z; a23 += w * n.z * d;
+            a33 += w * d * d;
+        }
+
+        void Add(const Quadric& q) {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+            a11 += q.a11; a12 += q.a12; a13 += q.a13;
+            a22 += q.a22; a23 += q.a23;
+            a33 += q.a33;
+            weight += q.weight;
+        }
+
+        double Evaluate(const glm::vec3& p) const {
+            double x = p.x, y = p.y, z = p.z;
+            double error = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+                         + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+                         + a22 * z * z + 2 * a23 * z
+                         + a33;
+            return std::max(error, 0.0);
+        }
+    };
+
+    struct Collapse {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+
+        bool operator<(const Collapse& other) const { return cost < other.cost; }
+    };
+
+    struct PositionHash {
+        size_t operator()(const glm::vec3& p) const {
+            uint32_t bits[3];
+            std::memcpy(bits, &p.x, sizeof(bits));
+            return bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u;
+        }
+    };
+
+    uint64_t EdgeKey(uint32_t a, uint32_t b) {
+        return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+    }
+
+}
+
+float MeshSimplifier::Simplify(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                               size_t targetIndexCount, std::vector<unsigned int>& out) {
+    out.clear();
+    const size_t vertexCount = vertices.size() / VERTEX_FLOATS;
+    const size_t triangleCount = indices.size() / 3;
+
+    auto positionOf = [&](unsigned int vertex) {
+        const float* v = &vertices[vertex * VERTEX_FLOATS];
+        return glm::vec3(v[0], v[1], v[2]);
+    };
+    auto normalOf = [&](unsigned int vertex) {
+        const float* v = &vertices[vertex * VERTEX_FLOATS + 3];
+        return glm::vec3(v[0], v[1], v[2]);
+    };
+
+    // Weld vertices that differ only in normal or UV
+    std::vector<uint32_t> weld(vertexCount);
+    std::vector<glm::vec3> positions;
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> positionIds;
+    for (size_t i = 0; i < vertexCount; i++) {
+        auto inserted = positionIds.emplace(positionOf((unsigned int)i), (uint32_t)positions.size());
+        if (inserted.second) positions.push_back(inserted.first->first);
+        weld[i] = inserted.first->second;
+    }
+
+    std::vector<std::vector<uint32_t>> verticesAt(positions.size());
+    for (size_t i = 0; i < vertexCount; i++) {
+        verticesAt[weld[i]].push_back((uint32_t)i);
+    }
+
+    // Face quadrics, weighted by area
+    std::vector<Quadric> quadrics(positions.size());
+    std::vector<std::vector<uint32_t>> trianglesAt(positions.size());
+    std::unordered_map<uint64_t, int> edgeUse;
+    for (size_t t = 0; t < triangleCount; t++) {
+        uint32_t p[3] = { weld[indices[t * 3]], weld[indices[t * 3 + 1]], weld[indices[t * 3 + 2]] };
+        glm::vec3 normal = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+        float length = glm::length(normal);
+
+        Quadric face;
+        if (length > 0.0f) {
+            normal /= length;
+            face.weight = length * 0.5;
+            face.AddPlane(normal, -glm::dot(normal, positions[p[0]]), face.weight);
+        }
+        for (int k = 0; k < 3; k++) {
+            quadrics[p[k]].Add(face);
+            trianglesAt[p[k]].push_back((uint32_t)t);
+            edgeUse[EdgeKey(p[k], p[(k + 1) % 3])]++;
+        }
+    }
+
+    // Border constraints
+    for (size_t t = 0; t < triangleCount; t++) {
+        uint32_t p[3] = { weld[indices[t * 3]], weld[indices[t * 3 + 1]], weld[indices[t * 3 + 2]] };
+        glm::vec3 faceNormal = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = p[k], b = p[(k + 1) % 3];
+            if (edgeUse[EdgeKey(a, b)] != 1) continue;
+
+            glm::vec3 edge = positions[b] - positions[a];
+            glm::vec3 normal = glm::cross(edge, faceNormal);
+            float length = glm::length(normal);
+            if (length <= 0.0f) continue;
+            normal /= length;
+
+            Quadric border;
+            border.AddPlane(normal, -glm::dot(normal, positions[a]), glm::dot(edge, edge) * BOUNDARY_WEIGHT);
+            quadrics[a].Add(border);
+            quadrics[b].Add(border);
+        }
+    }
+
+    std::vector<unsigned int> triangles(indices.begin(), indices.begin() + triangleCount * 3);
+    std::vector<bool> alive(triangleCount, true);
+    size_t aliveCount = triangleCount;
+    double maxError = 0.0;
+
+    auto positionOfCorner = [&](uint32_t t, int k) { return weld[triangles[t * 3 + k]]; };
+
+    // A collapse may not turn any surviving triangle around
+    auto flips = [&](uint32_t from, uint32_t to) {
+        for (uint32_t t : trianglesAt[from]) {
+            if (!alive[t]) continue;
+            uint32_t p[3] = { positionOfCorner(t, 0), positionOfCorner(t, 1), positionOfCorner(t, 2) };
+            if (p[0] == to || p[1] == to || p[2] == to) continue;
+
+            glm::vec3 before = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+            for (uint32_t& q : p) {
+                if (q == from) q = to;
+            }
+            glm::vec3 after = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+            if (glm::dot(before, after) <= 0.0f) return true;
+        }
+        return false;
+    };
+
+    std::vector<Collapse> candidates;
+    std::vector<uint64_t> edges;
+    std::vector<bool> locked(positions.size());
+    std::vector<uint32_t> snapped(vertexCount);
+
+    while (aliveCount * 3 > targetIndexCount) {
+        edges.clear();
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            if (!alive[t]) continue;
+            for (int k = 0; k < 3; k++) {
+                edges.push_back(EdgeKey(positionOfCorner(t, k), positionOfCorner(t, (k + 1) % 3)));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        candidates.clear();
+        for (uint64_t edge : edges) {
+            uint32_t a = (uint32_t)(edge >> 32), b = (uint32_t)edge;
+            Quadric combined = quadrics[a];
+            combined.Add(quadrics[b]);
+            double toA = combined.Evaluate(positions[a]);
+            double toB = combined.Evaluate(positions[b]);
+            candidates.push_back(toA < toB ? Collapse{ toA, b, a } : Collapse{ toB, a, b });
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        std::fill(locked.begin(), locked.end(), false);
+        size_t passLimit = std::max<size_t>(1, candidates.size() / PASS_FRACTION);
+        size_t collapsed = 0;
+
+        for (const Collapse& collapse : candidates) {
+            if (collapsed >= passLimit || aliveCount * 3 <= targetIndexCount) break;
+            uint32_t from = collapse.from, to = collapse.to;
+            if (locked[from] || locked[to] || flips(from, to)) continue;
+
+            // Each vertex on the removed position moves to the vertex on the
+            // kept one whose normal is closest, keeping hard edges hard
+            for (uint32_t vertex : verticesAt[from]) {
+                float bestDot = -2.0f;
+                for (uint32_t candidate : verticesAt[to]) {
+                    float d = glm::dot(normalOf(vertex), normalOf(candidate));
+                    if (d > bestDot) {
+                        bestDot = d;
+                        snapped[vertex] = candidate;
+                    }
+                }
+            }
+
+            for (uint32_t t : trianglesAt[from]) {
+                if (!alive[t]) continue;
+                uint32_t p[3] = { positionOfCorner(t, 0), positionOfCorner(t, 1), positionOfCorner(t, 2) };
+                if (p[0] == to || p[1] == to || p[2] == to) {
+                    alive[t] = false;
+                    aliveCount--;
+                    continue;
+                }
+                for (int k = 0; k < 3; k++) {
+                    if (p[k] == from) triangles[t * 3 + k] = snapped[triangles[t * 3 + k]];
+                }
+                trianglesAt[to].push_back(t);
+            }
+            trianglesAt[from].clear();
+            verticesAt[from].clear();
+
+            double weight = quadrics[from].weight + quadrics[to].weight;
+            if (weight > 0.0) {
+                maxError = std::max(maxError, std::sqrt(collapse.cost / weight));
+            }
+            quadrics[to].Add(quadrics[from]);
+            locked[from] = locked[to] = true;
+            collapsed++;
+        }
+
+        if (collapsed == 0) break;
+    }
+
+    out.reserve(aliveCount * 3);
+    for (size_t t = 0; t < triangleCount; t++) {
+        if (!alive[t]) continue;
+        out.insert(out.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+    }
+    return (float)maxError;
+}
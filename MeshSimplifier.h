@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class MeshSimplifier {
+public:
+    // Quadric-error edge collapse (Garland & Heckbert) on an indexed mesh with
+    // the pos(3), normal(3), uv(2) vertex layout. Collapses run on the mesh
+    // welded by position, so normal and UV seams cannot tear, and always move a
+    // vertex onto the other end of its edge; out indexes the same vertices as
+    // indices, which lets every level of detail share one vertex buffer.
+    // Returns the largest object-space distance error of any collapse made.
+    static float Simplify(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                          size_t targetIndexCount, std::vector<unsigned int>& out);
+};
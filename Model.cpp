@@ -4,15 +4,56 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
+#include "Renderer.h"
+#include "MeshSimplifier.h"
+#include "TextureCache.h"
 #include <glad/glad.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <unordered_map>
 
-Model::Model(const std::string& path, const std::string& baseDir) {
-    loadModel(path, baseDir);
+namespace {
+
+    using VertexKey = std::array<float, 8>;
+
+    struct VertexKeyHash {
+        size_t operator()(const VertexKey& key) const {
+            size_t hash = 2166136261u;
+            for (float f : key) {
+                uint32_t bits;
+                std::memcpy(&bits, &f, sizeof(bits));
+                hash = (hash ^ bits) * 16777619u;
+            }
+            return hash;
+        }
+    };
+
+    // .mtl files written on Windows often use backslashes
+    std::string texturePath(const std::string& baseDir, std::string name) {
+        std::replace(name.begin(), name.end(), '\\', '/');
+        return baseDir + name;
+    }
+
+}
+
+Model::Model(const std::string& path, const std::string& baseDir, const ModelLodSettings& lodSettings,
+             TextureCache* textures) {
+    loadModel(path, baseDir, textures);
+    buildLods(lodSettings);
     setupMesh();
+
+    std::cout << "Model " << path << ": " << vertices.size() / 8 << " vertices";
+    for (const ModelLod& lod : lods) {
+        std::cout << ", " << lod.indexCount / 3 << " triangles (error " << lod.error << ")";
+    }
+    std::cout << "\n";
 }
 
-void Model::loadModel(const std::string& path, const std::string& baseDir) {
+void Model::loadModel(const std::string& path, const std::string& baseDir, TextureCache* textures) {
     tinyobj::ObjReaderConfig reader_config;
     reader_config.mtl_search_path = baseDir;
 
@@ -32,8 +73,20 @@ void Model::loadModel(const std::string& path, const std::string& baseDir) {
     auto& shapes = reader.GetShapes();
 	auto& materials = reader.GetMaterials();
 
+    if (!attrib.vertices.empty()) {
+        boundsMin = boundsMax = glm::vec3(attrib.vertices[0], attrib.vertices[1], attrib.vertices[2]);
+        for (size_t i = 0; i + 2 < attrib.vertices.size(); i += 3) {
+            glm::vec3 position(attrib.vertices[i], attrib.vertices[i + 1], attrib.vertices[i + 2]);
+            boundsMin = glm::min(boundsMin, position);
+            boundsMax = glm::max(boundsMax, position);
+        }
+    }
     
 
+    // Corners that match exactly share a vertex, which the simplifier needs
+    std::unordered_map<VertexKey, unsigned int, VertexKeyHash> uniqueVertices;
+    int materialID = -1;
+
     for (size_t s = 0; s < shapes.size(); s++) {
         size_t index_offset = 0;
         for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
@@ -45,6 +98,7 @@ void Model::loadModel(const std::string& path, const std::string& baseDir) {
                 this->materialDiffuse = glm::vec3(mat.diffuse[0], mat.diffuse[1], mat.diffuse[2]);
                 this->materialSpecular = glm::vec3(mat.specular[0], mat.specular[1], mat.specular[2]);
                 this->materialShininess = mat.shininess; // careful, sometimes 0
+                materialID = matID;
             }
             for (size_t v = 0; v < fv; v++) {
                 tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
@@ -76,11 +130,64 @@ void Model::loadModel(const std::string& path, const std::string& baseDir) {
                     vertices.push_back(0.0f);
                 }
 
-                indices.push_back(static_cast<unsigned int>(indices.size()));
+                VertexKey key;
+                std::copy(vertices.end() - 8, vertices.end(), key.begin());
+                auto inserted = uniqueVertices.emplace(key, static_cast<unsigned int>(vertices.size() / 8 - 1));
+                if (!inserted.second) {
+                    vertices.resize(vertices.size() - 8);
+                }
+                indices.push_back(inserted.first->second);
             }
             index_offset += fv;
         }
     }
+
+    // Maps come from the cache, so models sharing a texture share its memory
+    if (textures && materialID >= 0) {
+        const tinyobj::material_t& mat = materials[materialID];
+        if (!mat.diffuse_texname.empty()) {
+            diffuseTexture = textures->Get(texturePath(baseDir, mat.diffuse_texname));
+        }
+        if (!mat.specular_texname.empty()) {
+            specularTexture = textures->Get(texturePath(baseDir, mat.specular_texname));
+        }
+    }
+}
+
+void Model::buildLods(const ModelLodSettings& settings) {
+    const std::vector<unsigned int> fullIndices = indices;
+    lods.push_back({ 0, static_cast<unsigned int>(fullIndices.size()), 0.0f });
+
+    // Every level simplifies the full mesh, so errors do not compound
+    std::vector<unsigned int> levelIndices;
+    float target = static_cast<float>(fullIndices.size() / 3);
+    for (int level = 1; level < settings.levelCount; level++) {
+        target *= settings.triangleRatio;
+        size_t targetIndexCount = static_cast<size_t>(target) * 3;
+        if (targetIndexCount < 3) break;
+
+        float error = MeshSimplifier::Simplify(vertices, fullIndices, targetIndexCount, levelIndices);
+
+        // Stop once the simplifier can no longer make meaningful progress
+        const ModelLod& previous = lods.back();
+        if (levelIndices.empty() || levelIndices.size() > previous.indexCount * 9 / 10) break;
+
+        ModelLod lod;
+        lod.firstIndex = static_cast<unsigned int>(indices.size());
+        lod.indexCount = static_cast<unsigned int>(levelIndices.size());
+        lod.error = std::max(error, previous.error);
+        indices.insert(indices.end(), levelIndices.begin(), levelIndices.end());
+        lods.push_back(lod);
+    }
+}
+
+int Model::SelectLod(float distance, float projectionScale, float maxPixelError) const {
+    int level = 0;
+    for (int i = 1; i < GetLodCount(); i++) {
+        if (lods[i].error * projectionScale > maxPixelError * distance) break;
+        level = i;
+    }
+    return level;
 }
 
 void Model::setupMesh() {
@@ -88,7 +195,7 @@ void Model::setupMesh() {
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
+    Renderer::BindVertexArray(VAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
@@ -106,11 +213,11 @@ void Model::setupMesh() {
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
 
-    glBindVertexArray(0);
+    Renderer::BindVertexArray(0);
 }
 
 void Model::Draw() {
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    Renderer::BindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, lods[0].indexCount, GL_UNSIGNED_INT, 0);
+    Renderer::BindVertexArray(0);
 }
@@ -1,21 +1,60 @@
 #pragma once
 #pragma once
+#include <memory>
 #include <string>
 #include <vector>
 #include <glm/glm.hpp>
 
+class Texture;
+class TextureCache;
+
+// Each level keeps about triangleRatio of the previous level's triangles
+struct ModelLodSettings {
+    int levelCount = 4;
+    float triangleRatio = 0.5f;
+};
+
+// One level of detail: a range of the model's index buffer, and how far (in
+// model units) its surface may be from the full-resolution one
+struct ModelLod {
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+    float error = 0.0f;
+};
+
 class Model {
 public:
-    Model(const std::string& path, const std::string& baseDir = "");
+    // Without a cache the .mtl texture maps are ignored
+    Model(const std::string& path, const std::string& baseDir = "", const ModelLodSettings& lodSettings = ModelLodSettings(),
+          TextureCache* textures = nullptr);
     void Draw(); // later: pass shader
+    unsigned int GetVAO() const { return VAO; }
+    unsigned int GetIndexCount() const { return lods[0].indexCount; }
+
+    // Levels of detail share the vertex buffer; level 0 is the full mesh
+    int GetLodCount() const { return static_cast<int>(lods.size()); }
+    const ModelLod& GetLod(int level) const { return lods[level]; }
+
+    // Coarsest level whose error projects to at most maxPixelError pixels at
+    // the given distance. projectionScale is viewport height / (2 tan(fovy / 2)).
+    int SelectLod(float distance, float projectionScale, float maxPixelError = 1.0f) const;
+    // Local-space bounding box as centre and half extent
+    glm::vec3 GetBoundsCenter() const { return (boundsMin + boundsMax) * 0.5f; }
+    glm::vec3 GetBoundsExtent() const { return (boundsMax - boundsMin) * 0.5f; }
     glm::vec3 materialDiffuse = glm::vec3(0.8f); // fallback gray
     glm::vec3 materialSpecular = glm::vec3(0.5f);
     float materialShininess = 32.0f;
+    std::shared_ptr<Texture> diffuseTexture;  // map_Kd, or null
+    std::shared_ptr<Texture> specularTexture; // map_Ks, or null
 
 private:
     unsigned int VAO, VBO, EBO;
     std::vector<float> vertices;
-    std::vector<unsigned int> indices;
+    std::vector<unsigned int> indices; // every level, back to back
+    std::vector<ModelLod> lods;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
     void setupMesh();
-    void loadModel(const std::string& path, const std::string& baseDir);
+    void loadModel(const std::string& path, const std::string& baseDir, TextureCache* textures);
+    void buildLods(const ModelLodSettings& settings);
 };
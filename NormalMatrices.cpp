@@ -0,0 +1,140 @@
+#include "NormalMatrices.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NORMALS_SSE2 1
+#endif
+
+namespace {
+
+    inline const float* ModelAt(const glm::mat4* models, size_t stride, size_t i) {
+        return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(models) + i * stride);
+    }
+
+    inline float* NormalAt(glm::vec4* normals, size_t stride, size_t i) {
+        return reinterpret_cast<float*>(reinterpret_cast<unsigned char*>(normals) + i * stride);
+    }
+
+    // Column-major upper 3x3: element (row r, column c) is m[c * 4 + r]
+    inline bool IsIdentity3x3(const float* m) {
+        return m[0] == 1.0f && m[1] == 0.0f && m[2] == 0.0f &&
+               m[4] == 0.0f && m[5] == 1.0f && m[6] == 0.0f &&
+               m[8] == 0.0f && m[9] == 0.0f && m[10] == 1.0f;
+    }
+
+    inline void WriteIdentity(float* n) {
+        n[0] = 1.0f; n[1] = 0.0f; n[2] = 0.0f;  n[3] = 0.0f;
+        n[4] = 0.0f; n[5] = 1.0f; n[6] = 0.0f;  n[7] = 0.0f;
+        n[8] = 0.0f; n[9] = 0.0f; n[10] = 1.0f; n[11] = 0.0f;
+    }
+
+    // transpose(inverse(A)) is the cofactor matrix over the determinant; cij
+    // is row i, column j. A singular matrix writes zero rather than infinities.
+    inline void WriteNormalMatrix(const float* m, float* n) {
+        float a00 = m[0], a10 = m[1], a20 = m[2];
+        float a01 = m[4], a11 = m[5], a21 = m[6];
+        float a02 = m[8], a12 = m[9], a22 = m[10];
+
+        float c00 = a11 * a22 - a12 * a21, c01 = a12 * a20 - a10 * a22, c02 = a10 * a21 - a11 * a20;
+        float c10 = a02 * a21 - a01 * a22, c11 = a00 * a22 - a02 * a20, c12 = a01 * a20 - a00 * a21;
+        float c20 = a01 * a12 - a02 * a11, c21 = a02 * a10 - a00 * a12, c22 = a00 * a11 - a01 * a10;
+
+        float det = a00 * c00 + a01 * c01 + a02 * c02;
+        float inv = det != 0.0f ? 1.0f / det : 0.0f;
+
+        n[0] = c00 * inv; n[1] = c10 * inv; n[2] = c20 * inv;  n[3] = 0.0f;
+        n[4] = c01 * inv; n[5] = c11 * inv; n[6] = c21 * inv;  n[7] = 0.0f;
+        n[8] = c02 * inv; n[9] = c12 * inv; n[10] = c22 * inv; n[11] = 0.0f;
+    }
+
+}
+
+const char* NormalMatrices::GetKernelName() {
+#if defined(NORMALS_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+size_t NormalMatrices::Compute(const glm::mat4* models, size_t modelStride,
+                               glm::vec4* normals, size_t normalStride, size_t count) {
+    size_t identities = 0;
+    size_t i = 0;
+
+#if defined(NORMALS_SSE2)
+    // Four matrices at a time, one per lane. Groups that are all identity
+    // (a grid of translated cubes, say) skip the arithmetic entirely.
+    for (; i + 4 <= count; i += 4) {
+        const float* m[4];
+        float* n[4];
+        int identityMask = 0;
+        for (int lane = 0; lane < 4; lane++) {
+            m[lane] = ModelAt(models, modelStride, i + lane);
+            n[lane] = NormalAt(normals, normalStride, i + lane);
+            identityMask |= IsIdentity3x3(m[lane]) << lane;
+        }
+        if (identityMask == 0xF) {
+            for (int lane = 0; lane < 4; lane++) {
+                WriteIdentity(n[lane]);
+            }
+            identities += 4;
+            continue;
+        }
+        for (int lane = 0; lane < 4; lane++) {
+            identities += (identityMask >> lane) & 1;
+        }
+
+        __m128 a00 = _mm_set_ps(m[3][0], m[2][0], m[1][0], m[0][0]);
+        __m128 a10 = _mm_set_ps(m[3][1], m[2][1], m[1][1], m[0][1]);
+        __m128 a20 = _mm_set_ps(m[3][2], m[2][2], m[1][2], m[0][2]);
+        __m128 a01 = _mm_set_ps(m[3][4], m[2][4], m[1][4], m[0][4]);
+        __m128 a11 = _mm_set_ps(m[3][5], m[2][5], m[1][5], m[0][5]);
+        __m128 a21 = _mm_set_ps(m[3][6], m[2][6], m[1][6], m[0][6]);
+        __m128 a02 = _mm_set_ps(m[3][8], m[2][8], m[1][8], m[0][8]);
+        __m128 a12 = _mm_set_ps(m[3][9], m[2][9], m[1][9], m[0][9]);
+        __m128 a22 = _mm_set_ps(m[3][10], m[2][10], m[1][10], m[0][10]);
+
+        __m128 c[9];
+        c[0] = _mm_sub_ps(_mm_mul_ps(a11, a22), _mm_mul_ps(a12, a21));
+        c[1] = _mm_sub_ps(_mm_mul_ps(a12, a20), _mm_mul_ps(a10, a22));
+        c[2] = _mm_sub_ps(_mm_mul_ps(a10, a21), _mm_mul_ps(a11, a20));
+        c[3] = _mm_sub_ps(_mm_mul_ps(a02, a21), _mm_mul_ps(a01, a22));
+        c[4] = _mm_sub_ps(_mm_mul_ps(a00, a22), _mm_mul_ps(a02, a20));
+        c[5] = _mm_sub_ps(_mm_mul_ps(a01, a20), _mm_mul_ps(a00, a21));
+        c[6] = _mm_sub_ps(_mm_mul_ps(a01, a12), _mm_mul_ps(a02, a11));
+        c[7] = _mm_sub_ps(_mm_mul_ps(a02, a10), _mm_mul_ps(a00, a12));
+        c[8] = _mm_sub_ps(_mm_mul_ps(a00, a11), _mm_mul_ps(a01, a10));
+
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a00, c[0]), _mm_mul_ps(a01, c[1])), _mm_mul_ps(a02, c[2]));
+        __m128 nonZero = _mm_cmpneq_ps(det, _mm_setzero_ps());
+        __m128 inv = _mm_and_ps(nonZero, _mm_div_ps(_mm_set1_ps(1.0f), det));
+
+        // Lane-major scratch, so each matrix is written out as three columns;
+        // c[3 * i + j] holds cofactor ij
+        alignas(16) float lanes[9][4];
+        for (int k = 0; k < 9; k++) {
+            _mm_store_ps(lanes[k], _mm_mul_ps(c[k], inv));
+        }
+        for (int lane = 0; lane < 4; lane++) {
+            float* out = n[lane];
+            out[0] = lanes[0][lane]; out[1] = lanes[3][lane]; out[2] = lanes[6][lane];  out[3] = 0.0f;
+            out[4] = lanes[1][lane]; out[5] = lanes[4][lane]; out[6] = lanes[7][lane];  out[7] = 0.0f;
+            out[8] = lanes[2][lane]; out[9] = lanes[5][lane]; out[10] = lanes[8][lane]; out[11] = 0.0f;
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        const float* m = ModelAt(models, modelStride, i);
+        float* n = NormalAt(normals, normalStride, i);
+        if (IsIdentity3x3(m)) {
+            WriteIdentity(n);
+            identities++;
+        }
+        else {
+            WriteNormalMatrix(m, n);
+        }
+    }
+    return identities;
+}
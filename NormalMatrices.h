@@ -0,0 +1,19 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+
+class NormalMatrices {
+public:
+    // transpose(inverse(mat3(model))) for a batch of model matrices, so vertex
+    // shaders never invert a matrix per vertex. Each result is written as three
+    // vec4 columns (w unused), the layout of both the draw data texels and the
+    // instance attributes. models and normals are strided in bytes, which lets
+    // the batch run over DrawData records in place. Models whose upper 3x3 is
+    // the identity, like anything only translated, skip the arithmetic.
+    // Returns how many took that path.
+    static size_t Compute(const glm::mat4* models, size_t modelStride,
+                          glm::vec4* normals, size_t normalStride, size_t count);
+
+    static const char* GetKernelName();
+};
@@ -0,0 +1,161 @@
+#include "OcclusionCuller.h"
+
+namespace {
+
+    // Boxes test against the depth buffer without changing it
+    PipelineStateDesc BoxPipelineDesc() {
+        PipelineStateDesc desc;
+        desc.depthFunc = GL_LEQUAL;
+        desc.depthWrite = false;
+        desc.colorWrite = false;
+        return desc;
+    }
+
+    // Objects unseen for this many frames give their query back
+    const uint64_t EVICT_AFTER_FRAMES = 120;
+
+    // Boxes the camera is inside get clipped by the near plane, so they are never queried
+    const float NEAR_MARGIN = 0.2f;
+
+}
+
+OcclusionCuller::OcclusionCuller()
+    : m_boxShader("resources/Shaders/occlusion_box.glsl"),
+      m_boxVAO(0), m_boxVBO(0), m_boxEBO(0),
+      m_boxPipeline(BoxPipelineDesc())
+{
+    m_boxCenter = m_boxShader.GetUniform<glm::vec3>("u_boxCenter");
+    m_boxExtent = m_boxShader.GetUniform<glm::vec3>("u_boxExtent");
+
+    // Corners of the [-1, 1] cube, scaled by the box's half extent in the shader
+    float corners[] = {
+        -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f,  1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,   1.0f,  1.0f,  1.0f,  -1.0f,  1.0f,  1.0f
+    };
+    unsigned int indices[] = {
+        0, 2, 1,  2, 0, 3,   // back
+        4, 5, 6,  6, 7, 4,   // front
+        0, 4, 7,  7, 3, 0,   // left
+        1, 2, 6,  6, 5, 1,   // right
+        0, 1, 5,  5, 4, 0,   // bottom
+        3, 7, 6,  6, 2, 3    // top
+    };
+
+    glGenVertexArrays(1, &m_boxVAO);
+    glGenBuffers(1, &m_boxVBO);
+    glGenBuffers(1, &m_boxEBO);
+
+    Renderer::BindVertexArray(m_boxVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_boxVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_boxEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    Renderer::BindVertexArray(0);
+}
+
+OcclusionCuller::~OcclusionCuller() {
+    for (auto& entry : m_objects) {
+        glDeleteQueries(1, &entry.second.query);
+    }
+    glDeleteVertexArrays(1, &m_boxVAO);
+    Renderer::OnVertexArrayDeleted(m_boxVAO);
+    glDeleteBuffers(1, &m_boxVBO);
+    glDeleteBuffers(1, &m_boxEBO);
+}
+
+void OcclusionCuller::BeginFrame(const glm::vec3& cameraPos, const glm::vec3& cameraFront) {
+    m_frame++;
+    m_cameraPos = cameraPos;
+    m_candidates.clear();
+    m_conditionalQueue.Begin(cameraPos, cameraFront);
+
+    // Poll without blocking; a query still in flight keeps the last known answer
+    for (auto& entry : m_objects) {
+        ObjectState& state = entry.second;
+        if (!state.pending) continue;
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(state.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+
+        GLuint anySamples = GL_FALSE;
+        glGetQueryObjectuiv(state.query, GL_QUERY_RESULT, &anySamples);
+        state.visible = anySamples != GL_FALSE;
+        state.pending = false;
+    }
+
+    EvictStaleObjects();
+}
+
+void OcclusionCuller::EvictStaleObjects() {
+    if (m_frame % EVICT_AFTER_FRAMES != 0) return;
+
+    for (auto it = m_objects.begin(); it != m_objects.end();) {
+        if (m_frame - it->second.lastFrame > EVICT_AFTER_FRAMES) {
+            glDeleteQueries(1, &it->second.query);
+            it = m_objects.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void OcclusionCuller::Submit(RenderQueue& queue, uint64_t id, const RenderItem& item, const glm::vec3& center, const glm::vec3& extent) {
+    ObjectState& state = m_objects[id];
+    if (state.query == 0) {
+        glGenQueries(1, &state.query);
+    }
+    state.lastFrame = m_frame;
+
+    glm::vec3 offset = glm::abs(m_cameraPos - center);
+    glm::vec3 reach = extent + glm::vec3(NEAR_MARGIN);
+    if (offset.x <= reach.x && offset.y <= reach.y && offset.z <= reach.z) {
+        state.visible = true;
+    }
+    else {
+        m_candidates.push_back({ &state, center, extent });
+    }
+
+    if (state.visible) {
+        queue.Submit(RenderPass::Opaque, item, center);
+    }
+    else {
+        RenderItem conditional = item;
+        conditional.conditionQuery = state.query;
+        m_conditionalQueue.Submit(RenderPass::Opaque, conditional, center);
+    }
+}
+
+void OcclusionCuller::IssueQueries() {
+    m_queryCount = 0;
+    m_testedCount = static_cast<int>(m_candidates.size());  // objects around the camera are not tested
+    m_occludedCount = 0;
+
+    Renderer::ApplyPipelineState(m_boxPipeline);
+    m_boxShader.Use();
+    Renderer::BindVertexArray(m_boxVAO);
+
+    for (const Candidate& candidate : m_candidates) {
+        ObjectState& state = *candidate.state;
+        if (!state.visible) m_occludedCount++;
+        if (state.pending) continue;
+
+        m_boxShader.Set(m_boxCenter, candidate.center);
+        m_boxShader.Set(m_boxExtent, candidate.extent);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, state.query);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        state.pending = true;
+        m_queryCount++;
+    }
+}
+
+void OcclusionCuller::Execute(DrawSubmitter& submitter, const PipelineState& scenePipeline) {
+    IssueQueries();
+
+    Renderer::ApplyPipelineState(scenePipeline);
+    m_conditionalQueue.Execute(submitter);
+}
\ No newline at end of file
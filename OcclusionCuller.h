@@ -0,0 +1,84 @@
+#pragma once
+
+#include "RenderQueue.h"
+#include "Renderer.h"
+#include "Shader.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Callers tag their object ids with a group so they cannot collide
+enum class OcclusionGroup : uint32_t {
+    Scene = 0,
+    Chunks = 1
+};
+
+inline uint64_t OcclusionId(OcclusionGroup group, uint32_t index) {
+    return ((uint64_t)group << 32) | index;
+}
+
+// Hardware occlusion culling with temporal coherence. Objects that were
+// visible last frame go straight to the caller's queue and fill the depth
+// buffer. Every object then gets its bounding box drawn into an
+// GL_ANY_SAMPLES_PASSED query, and objects that were hidden last frame are
+// drawn under glBeginConditionalRender on that query, so the GPU decides
+// whether they are shaded. Results are read back only once available, and
+// an object keeps its last known visibility while its query is in flight, so
+// the CPU never waits on the GPU.
+class OcclusionCuller {
+public:
+    OcclusionCuller();
+    ~OcclusionCuller();
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    // Collect finished query results and start a new frame
+    void BeginFrame(const glm::vec3& cameraPos, const glm::vec3& cameraFront);
+
+    // Queue an object: into queue if it was visible last frame, otherwise
+    // into the culler's conditional queue. center/extent are its world AABB.
+    void Submit(RenderQueue& queue, uint64_t id, const RenderItem& item, const glm::vec3& center, const glm::vec3& extent);
+
+    // Call after the caller's queue has executed: issue this frame's box
+    // queries with the bound camera, then draw the conditional queue with the
+    // scene's pipeline state
+    void Execute(DrawSubmitter& submitter, const PipelineState& scenePipeline);
+
+    // Objects hidden by their latest available result, and queries issued this frame
+    int GetOccludedCount() const { return m_occludedCount; }
+    int GetTestedCount() const { return m_testedCount; }
+    int GetQueryCount() const { return m_queryCount; }
+
+private:
+    struct ObjectState {
+        unsigned int query = 0;
+        bool pending = false;  // a query is in flight
+        bool visible = true;   // latest available result; new objects are assumed visible
+        uint64_t lastFrame = 0;
+    };
+
+    struct Candidate {
+        ObjectState* state;
+        glm::vec3 center;
+        glm::vec3 extent;
+    };
+
+    std::unordered_map<uint64_t, ObjectState> m_objects;
+    std::vector<Candidate> m_candidates;
+    RenderQueue m_conditionalQueue;
+    uint64_t m_frame = 0;
+    glm::vec3 m_cameraPos = glm::vec3(0.0f);
+
+    Shader m_boxShader;
+    Uniform<glm::vec3> m_boxCenter, m_boxExtent;
+    unsigned int m_boxVAO, m_boxVBO, m_boxEBO;
+    PipelineState m_boxPipeline;
+
+    int m_occludedCount = 0;
+    int m_testedCount = 0;
+    int m_queryCount = 0;
+
+    void IssueQueries();
+    void EvictStaleObjects();
+};
\ No newline at end of file
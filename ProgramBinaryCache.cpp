@@ -0,0 +1,129 @@
+#include "ProgramBinaryCache.h"
+#include "Renderer.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+    const uint32_t CACHE_MAGIC = 0x31424750; // "PGB1"
+
+    struct CacheHeader {
+        uint32_t magic;
+        uint32_t format; // binary format the driver reported
+        uint64_t key;
+        uint32_t length;
+        uint32_t padding;
+    };
+
+    const uint64_t FNV_OFFSET = 14695981039346656037ull;
+    const uint64_t FNV_PRIME = 1099511628211ull;
+
+    uint64_t Fnv1a(uint64_t hash, const std::string& text) {
+        for (unsigned char c : text) {
+            hash = (hash ^ c) * FNV_PRIME;
+        }
+        // Separator, so moving text between stages changes the key
+        return (hash ^ 0xFF) * FNV_PRIME;
+    }
+
+    std::string GlString(GLenum name) {
+        const GLubyte* value = glGetString(name);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+
+}
+
+bool ProgramBinaryCache::s_enabled = false;
+std::string ProgramBinaryCache::s_directory;
+std::string ProgramBinaryCache::s_driver;
+int ProgramBinaryCache::s_hits = 0;
+int ProgramBinaryCache::s_misses = 0;
+
+void ProgramBinaryCache::Initialize(const std::string& directory) {
+    if (!Renderer::GetCaps().programBinary) {
+        std::cout << "Program binary cache: not supported by this context" << std::endl;
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Program binary cache: cannot create " << directory << ": " << error.message() << std::endl;
+        return;
+    }
+
+    s_directory = directory;
+    s_driver = GlString(GL_VENDOR) + "\n" + GlString(GL_RENDERER) + "\n" + GlString(GL_VERSION);
+    s_enabled = true;
+}
+
+uint64_t ProgramBinaryCache::Key(const std::string& vertexSource, const std::string& fragmentSource) {
+    uint64_t hash = Fnv1a(FNV_OFFSET, s_driver);
+    hash = Fnv1a(hash, vertexSource);
+    return Fnv1a(hash, fragmentSource);
+}
+
+std::string ProgramBinaryCache::PathOf(uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return s_directory + "/" + name;
+}
+
+unsigned int ProgramBinaryCache::Load(uint64_t key) {
+    if (!s_enabled) return 0;
+
+    std::ifstream file(PathOf(key), std::ios::binary | std::ios::ate);
+    std::streamoff fileSize = file.tellg();
+    file.seekg(0);
+    CacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != CACHE_MAGIC || header.key != key) {
+        s_misses++;
+        return 0;
+    }
+    // A truncated or corrupt file must not size the allocation
+    if (header.length == 0 || header.length != fileSize - static_cast<std::streamoff>(sizeof(header))) {
+        s_misses++;
+        return 0;
+    }
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size())) {
+        s_misses++;
+        return 0;
+    }
+
+    unsigned int program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        // Usually a driver update that kept its version string
+        glDeleteProgram(program);
+        s_misses++;
+        return 0;
+    }
+    s_hits++;
+    return program;
+}
+
+void ProgramBinaryCache::Store(uint64_t key, unsigned int program) {
+    if (!s_enabled) return;
+
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    CacheHeader header = { CACHE_MAGIC, format, key, static_cast<uint32_t>(length), 0 };
+    std::ofstream file(PathOf(key), std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), length);
+    if (!file) {
+        std::cerr << "Program binary cache: failed to write " << PathOf(key) << std::endl;
+    }
+}
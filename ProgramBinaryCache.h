@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// On-disk cache of linked program binaries, one file per program. Programs
+// are keyed by a 64-bit FNV-1a hash of their stage sources (defines included)
+// and the driver's vendor, renderer and version strings, so an edited shader
+// or a driver update misses instead of loading a stale binary. A driver may
+// still reject a binary it wrote; Load then reports a miss and the caller
+// compiles from source, which overwrites the file.
+class ProgramBinaryCache {
+public:
+    // Enable the cache in directory, created if missing. Stays disabled when
+    // the context cannot hand out program binaries.
+    static void Initialize(const std::string& directory);
+    static bool IsEnabled() { return s_enabled; }
+
+    static uint64_t Key(const std::string& vertexSource, const std::string& fragmentSource);
+
+    // A linked program from the cache, or 0 on a miss or a rejected binary
+    static unsigned int Load(uint64_t key);
+
+    // Save a program linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    static void Store(uint64_t key, unsigned int program);
+
+    static int GetHitCount() { return s_hits; }
+    static int GetMissCount() { return s_misses; }
+
+private:
+    static bool s_enabled;
+    static std::string s_directory;
+    static std::string s_driver;
+    static int s_hits;
+    static int s_misses;
+
+    static std::string PathOf(uint64_t key);
+};
@@ -0,0 +1,214 @@
+#include "RenderQueue.h"
+#include "Renderer.h"
+#include "Shader.h"
+#include "Texture.h"
+#include <algorithm>
+#include <numeric>
+
+void RenderQueue::Begin(const glm::vec3& cameraPos, const glm::vec3& cameraFront, float maxDepth) {
+    m_items.clear();
+    m_keys.clear();
+    m_cameraPos = cameraPos;
+    m_cameraFront = cameraFront;
+    m_maxDepth = maxDepth;
+    m_sorted = false;
+    m_skippedCount = 0;
+}
+
+void RenderQueue::Submit(RenderPass pass, const RenderItem& item, const glm::vec3& worldCenter) {
+    // A program still building would stall the frame; the item waits for a later one
+    if (!item.shader->IsReady()) {
+        m_skippedCount++;
+        return;
+    }
+
+    float depth = glm::dot(worldCenter - m_cameraPos, m_cameraFront);
+    m_keys.push_back(MakeKey(pass, item, depth));
+    m_items.push_back(item);
+    m_sorted = false;
+}
+
+uint32_t RenderQueue::DenseId(std::unordered_map<unsigned int, uint32_t>& ids, unsigned int name) {
+    auto it = ids.find(name);
+    if (it != ids.end()) return it->second;
+
+    uint32_t id = static_cast<uint32_t>(ids.size());
+    ids[name] = id;
+    return id;
+}
+
+uint64_t RenderQueue::MaterialKey(const RenderItem& item) {
+    uint64_t diffuse = item.textures[0] ? item.textures[0]->GetID() : 0;
+    uint64_t specular = item.textures[1] ? item.textures[1]->GetID() : 0;
+    return (diffuse << 32) | specular;
+}
+
+uint64_t RenderQueue::MakeKey(RenderPass pass, const RenderItem& item, float depth) {
+    // Ids that overflow their field only make grouping worse, never the result wrong
+    uint64_t program = DenseId(m_programIds, item.shader->GetID()) & 0xFF;
+    uint64_t vao = DenseId(m_vaoIds, item.vao) & 0xFF;
+
+    uint64_t materialKey = MaterialKey(item);
+    auto it = m_materialIds.find(materialKey);
+    if (it == m_materialIds.end()) {
+        it = m_materialIds.emplace(materialKey, static_cast<uint32_t>(m_materialIds.size())).first;
+    }
+    uint64_t material = it->second & 0xFFF;
+
+    float normalized = glm::clamp(depth / m_maxDepth, 0.0f, 1.0f);
+    if (pass == RenderPass::Transparent) {
+        normalized = 1.0f - normalized;
+    }
+    uint64_t quantisedDepth = static_cast<uint64_t>(normalized * 0xFFFFFF);
+
+    return ((uint64_t)pass << 62) | (program << 54) | (material << 42) | (vao << 34) | (quantisedDepth << 10);
+}
+
+void RenderQueue::RadixSort() {
+    size_t count = m_keys.size();
+    m_keyScratch.resize(count);
+    m_orderScratch.resize(count);
+
+    // LSD radix sort, one byte per pass; bytes every key shares are skipped
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t offsets[256] = {};
+        for (size_t i = 0; i < count; i++) {
+            offsets[(m_keys[i] >> shift) & 0xFF]++;
+        }
+        if (offsets[(m_keys[0] >> shift) & 0xFF] == count) continue;
+
+        size_t sum = 0;
+        for (size_t& offset : offsets) {
+            size_t bucket = offset;
+            offset = sum;
+            sum += bucket;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            size_t dst = offsets[(m_keys[i] >> shift) & 0xFF]++;
+            m_keyScratch[dst] = m_keys[i];
+            m_orderScratch[dst] = m_order[i];
+        }
+
+        m_keys.swap(m_keyScratch);
+        m_order.swap(m_orderScratch);
+    }
+}
+
+StateSwitches RenderQueue::CountSwitches(const uint32_t* order) const {
+    StateSwitches switches;
+    const Shader* program = nullptr;
+    unsigned int vao = ~0u;
+    const Texture* bound[2] = { nullptr, nullptr };
+
+    for (size_t i = 0; i < m_items.size(); i++) {
+        const RenderItem& item = m_items[order[i]];
+        if (item.shader != program) {
+            program = item.shader;
+            switches.programs++;
+        }
+        if (item.vao != vao) {
+            vao = item.vao;
+            switches.vertexArrays++;
+        }
+        for (int unit = 0; unit < 2; unit++) {
+            if (item.textures[unit] && item.textures[unit] != bound[unit]) {
+                bound[unit] = item.textures[unit];
+                switches.textures++;
+            }
+        }
+    }
+    return switches;
+}
+
+void RenderQueue::Sort() {
+    if (m_sorted) return;
+
+    m_order.resize(m_items.size());
+    std::iota(m_order.begin(), m_order.end(), 0);
+
+    // What drawing in submission order would have cost
+    m_unsortedSwitches = CountSwitches(m_order.data());
+    RadixSort();
+    m_sortedSwitches = CountSwitches(m_order.data());
+    m_sorted = true;
+}
+
+void RenderQueue::ExecuteDepthOnly(DrawSubmitter& submitter, const Shader& depthShader) {
+    if (m_items.empty()) return;
+    Sort();
+
+    depthShader.Use();
+    unsigned int vao = ~0u;
+    for (size_t i = 0; i < m_order.size(); i++) {
+        // Opaque items sort first; conditional ones wait for their query in Execute
+        if ((RenderPass)(m_keys[i] >> 62) != RenderPass::Opaque) break;
+        const RenderItem& item = m_items[m_order[i]];
+        if (item.conditionQuery != 0) continue;
+
+        // With one program and no textures, only the VAO splits batches
+        if (item.vao != vao) {
+            submitter.Submit();
+            vao = item.vao;
+            Renderer::BindVertexArray(vao);
+        }
+        submitter.Add(item.indexCount, item.firstIndex, item.baseVertex, item.data);
+    }
+    submitter.Submit();
+}
+
+void RenderQueue::Execute(DrawSubmitter& submitter) {
+    m_executedCount = static_cast<int>(m_items.size());
+    if (m_items.empty()) return;
+    Sort();
+
+    const Shader* program = nullptr;
+    unsigned int vao = ~0u;
+    const Texture* bound[2] = { nullptr, nullptr };
+
+    for (uint32_t index : m_order) {
+        const RenderItem& item = m_items[index];
+
+        bool textureChange = false;
+        for (int unit = 0; unit < 2; unit++) {
+            textureChange |= item.textures[unit] && item.textures[unit] != bound[unit];
+        }
+
+        // Any state change ends the current batch
+        if (item.shader != program || item.vao != vao || textureChange) {
+            submitter.Submit();
+        }
+
+        if (item.shader != program) {
+            program = item.shader;
+            program->Use();
+        }
+        if (item.vao != vao) {
+            vao = item.vao;
+            Renderer::BindVertexArray(vao);
+        }
+        for (int unit = 0; unit < 2; unit++) {
+            if (item.textures[unit] && item.textures[unit] != bound[unit]) {
+                bound[unit] = item.textures[unit];
+                bound[unit]->Bind(unit);
+            }
+        }
+
+        if (item.conditionQuery != 0) {
+            // The condition applies to whole draw calls, so this one cannot share a batch
+            submitter.Submit();
+            glBeginConditionalRender(item.conditionQuery, GL_QUERY_NO_WAIT);
+            submitter.Add(item.indexCount, item.firstIndex, item.baseVertex, item.data);
+            submitter.Submit();
+            glEndConditionalRender();
+            continue;
+        }
+
+        submitter.Add(item.indexCount, item.firstIndex, item.baseVertex, item.data);
+    }
+    submitter.Submit();
+
+    m_items.clear();
+    m_keys.clear();
+    m_sorted = false;
+}
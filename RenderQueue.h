@@ -0,0 +1,91 @@
+#pragma once
+
+#include "DrawSubmitter.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Shader;
+class Texture;
+
+enum class RenderPass : uint8_t {
+    Opaque = 0,      // sorted front to back for early-Z
+    Transparent = 1  // sorted back to front
+};
+
+// One draw plus the state it needs
+struct RenderItem {
+    const Shader* shader = nullptr;
+    unsigned int vao = 0;
+    const Texture* textures[2] = { nullptr, nullptr }; // material maps on units 0 and 1
+    unsigned int indexCount = 0;
+    unsigned int firstIndex = 0;
+    int baseVertex = 0;
+    DrawData data;
+    unsigned int conditionQuery = 0; // if set, drawn under conditional rendering on this query
+};
+
+// State changes needed to draw a frame's items in a given order
+struct StateSwitches {
+    int programs = 0;
+    int vertexArrays = 0;
+    int textures = 0;
+};
+
+// Collects a frame's draws, radix-sorts them by a 64-bit key and executes
+// them with the minimum of program, VAO and texture changes. Consecutive
+// items sharing all three go to the DrawSubmitter as one batch; conditional
+// items are submitted on their own.
+//
+// Key layout, most significant first:
+//   63-62 pass | 61-54 program | 53-42 material | 41-34 VAO | 33-10 depth | 9-0 unused
+class RenderQueue {
+public:
+    // Camera used for the depth part of the key; depth is quantised over [0, maxDepth]
+    void Begin(const glm::vec3& cameraPos, const glm::vec3& cameraFront, float maxDepth = 256.0f);
+
+    // Items whose program is still building are dropped for this frame
+    void Submit(RenderPass pass, const RenderItem& item, const glm::vec3& worldCenter);
+
+    // Depth pre-pass: draw the opaque items in sorted order with one
+    // position-only program, binding no textures. Items stay queued for Execute.
+    void ExecuteDepthOnly(DrawSubmitter& submitter, const Shader& depthShader);
+
+    // Sort and draw everything submitted since Begin
+    void Execute(DrawSubmitter& submitter);
+
+    int GetItemCount() const { return m_executedCount; }
+    int GetSkippedCount() const { return m_skippedCount; } // waiting on a program build
+    const StateSwitches& GetUnsortedSwitches() const { return m_unsortedSwitches; }
+    const StateSwitches& GetSortedSwitches() const { return m_sortedSwitches; }
+
+private:
+    std::vector<RenderItem> m_items;
+    std::vector<uint64_t> m_keys;
+    std::vector<uint32_t> m_order;
+    std::vector<uint64_t> m_keyScratch;
+    std::vector<uint32_t> m_orderScratch;
+
+    glm::vec3 m_cameraPos = glm::vec3(0.0f);
+    glm::vec3 m_cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+    float m_maxDepth = 256.0f;
+    int m_executedCount = 0;
+    int m_skippedCount = 0;
+    bool m_sorted = false;
+
+    // Dense ids so GL object names fit in their key fields
+    std::unordered_map<unsigned int, uint32_t> m_programIds;
+    std::unordered_map<unsigned int, uint32_t> m_vaoIds;
+    std::unordered_map<uint64_t, uint32_t> m_materialIds;
+
+    StateSwitches m_unsortedSwitches;
+    StateSwitches m_sortedSwitches;
+
+    uint64_t MakeKey(RenderPass pass, const RenderItem& item, float depth);
+    void Sort();
+    void RadixSort();
+    StateSwitches CountSwitches(const uint32_t* order) const;
+
+    static uint32_t DenseId(std::unordered_map<unsigned int, uint32_t>& ids, unsigned int name);
+    static uint64_t MaterialKey(const RenderItem& item);
+};
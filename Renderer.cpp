@@ -1,6 +1,20 @@
 #include "Renderer.h"
+#include "RingBuffer.h"
+#include "Shader.h"
+
+namespace {
+
+    // Starting size of each frame's region in the frame ring; it grows on demand
+    const size_t FRAME_RING_REGION_SIZE = 4 * 1024 * 1024;
+
+}
 
 GLFWwindow* Renderer::s_window = nullptr;
+RendererCaps Renderer::s_caps;
+RingBuffer* Renderer::s_frameRing = nullptr;
+Renderer::StateShadow Renderer::s_state;
+int Renderer::s_issuedCalls = 0;
+int Renderer::s_elidedCalls = 0;
 
 bool Renderer::Initialize() {
     // Initialize GLFW
@@ -9,13 +23,17 @@ bool Renderer::Initialize() {
         return false;
     }
 
-    // Configure GLFW
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Configure GLFW: prefer a 4.3 core context for indirect drawing, fall back to 3.3
+    const int contextVersions[][2] = { { 4, 3 }, { 3, 3 } };
+    for (auto& version : contextVersions) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    // Create window
-    s_window = glfwCreateWindow(s_windowWidth, s_windowHeight, "OpenGL Window", nullptr, nullptr);
+        // Create window
+        s_window = glfwCreateWindow(s_windowWidth, s_windowHeight, "OpenGL Window", nullptr, nullptr);
+        if (s_window) break;
+    }
     if (!s_window) {
         std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -32,10 +50,48 @@ bool Renderer::Initialize() {
         return false;
     }
 
+    s_caps.glMajor = GLVersion.major;
+    s_caps.glMinor = GLVersion.minor;
+    s_caps.multiDrawIndirect = GLAD_GL_VERSION_4_3 != 0;
+    s_caps.bufferStorage = GLAD_GL_VERSION_4_4 != 0 || GLAD_GL_ARB_buffer_storage != 0;
+    s_caps.pipelineStatistics = GLAD_GL_VERSION_4_6 != 0 || GLAD_GL_ARB_pipeline_statistics_query != 0;
+    if (GLAD_GL_VERSION_4_1 != 0 || GLAD_GL_ARB_get_program_binary != 0) {
+        GLint binaryFormats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+        s_caps.programBinary = binaryFormats > 0;
+    }
+
+    s_caps.textureS3TC = GLAD_GL_EXT_texture_compression_s3tc != 0;
+    s_caps.textureBPTC = GLAD_GL_VERSION_4_2 != 0 || GLAD_GL_ARB_texture_compression_bptc != 0;
+
+    // Let the driver compile on as many threads as it likes
+    if (GLAD_GL_KHR_parallel_shader_compile != 0) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        s_caps.parallelShaderCompile = true;
+    }
+    else if (GLAD_GL_ARB_parallel_shader_compile != 0) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        s_caps.parallelShaderCompile = true;
+    }
+
+    std::cout << "OpenGL " << s_caps.glMajor << "." << s_caps.glMinor
+              << (s_caps.multiDrawIndirect ? " (multi-draw indirect)" : " (base-vertex fallback)")
+              << (s_caps.bufferStorage ? " (persistent mapping)" : "") << std::endl;
+
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &s_caps.uniformBufferAlignment);
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &s_caps.maxTextureBufferSize);
+
+    InvalidateStateCache();
+    // Draw data is read through an RGBA32F texture buffer over the whole
+    // ring, which sees no further than the texel limit
+    s_frameRing = new RingBuffer(FRAME_RING_REGION_SIZE, (size_t)s_caps.maxTextureBufferSize * sizeof(glm::vec4));
+
     return true;
 }
 
 void Renderer::Cleanup() {
+    delete s_frameRing;
+    s_frameRing = nullptr;
     glfwDestroyWindow(s_window);
     glfwTerminate();
 }
@@ -60,6 +116,166 @@ void Renderer::BeginImGuiFrame() {
 void Renderer::EndImGuiFrame() {
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+    // The backend restores the fixed-function state it changes, but binds its own objects
+    InvalidateBindings();
+}
+
+void Renderer::BeginFrame() {
+    s_frameRing->BeginFrame();
+}
+
+void Renderer::EndFrame() {
+    s_frameRing->EndFrame();
+}
+
+void Renderer::SetCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position) {
+    CameraBlockData data;
+    data.view = view;
+    data.proj = projection;
+    data.viewProj = projection * view;
+    data.position = glm::vec4(position, 1.0f);
+
+    size_t offset = s_frameRing->Write(&data, sizeof(data), s_caps.uniformBufferAlignment);
+    if (offset == RingBuffer::INVALID_OFFSET) return;
+    glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, s_frameRing->GetID(), offset, sizeof(data));
+}
+
+void Renderer::UseProgram(unsigned int program) {
+    if (s_state.program == program) {
+        s_elidedCalls++;
+        return;
+    }
+    glUseProgram(program);
+    s_state.program = program;
+    s_issuedCalls++;
+}
+
+void Renderer::BindVertexArray(unsigned int vao) {
+    if (s_state.vao == vao) {
+        s_elidedCalls++;
+        return;
+    }
+    glBindVertexArray(vao);
+    s_state.vao = vao;
+    s_issuedCalls++;
+}
+
+void Renderer::SetActiveTextureUnit(unsigned int unit) {
+    if (s_state.activeUnit == unit) {
+        s_elidedCalls++;
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0 + unit);
+    s_state.activeUnit = unit;
+    s_issuedCalls++;
+}
+
+void Renderer::BindTexture(unsigned int unit, GLenum target, unsigned int texture) {
+    // Only the targets the engine uses are shadowed; anything else always goes through
+    unsigned int* bound = nullptr;
+    if (unit < (unsigned int)s_maxTextureUnits) {
+        if (target == GL_TEXTURE_2D) bound = &s_state.textures2D[unit];
+        else if (target == GL_TEXTURE_BUFFER) bound = &s_state.texturesBuffer[unit];
+    }
+
+    if (bound && *bound == texture) {
+        s_elidedCalls++;
+        return;
+    }
+
+    SetActiveTextureUnit(unit);
+    glBindTexture(target, texture);
+    s_issuedCalls++;
+    if (bound) *bound = texture;
+}
+
+void Renderer::BindTextureForUpdate(unsigned int unit, GLenum target, unsigned int texture) {
+    SetActiveTextureUnit(unit);
+    BindTexture(unit, target, texture);
+}
+
+void Renderer::ApplyPipelineState(const PipelineState& state) {
+    const PipelineStateDesc& next = state.GetDesc();
+    const PipelineStateDesc& current = s_state.pipeline;
+    bool force = !s_state.pipelineValid;
+
+    auto changed = [force](bool differs) {
+        if (force || differs) {
+            s_issuedCalls++;
+            return true;
+        }
+        s_elidedCalls++;
+        return false;
+    };
+    auto setCapability = [](GLenum capability, bool enabled) {
+        if (enabled) glEnable(capability);
+        else glDisable(capability);
+    };
+
+    if (changed(current.depthTest != next.depthTest))
+        setCapability(GL_DEPTH_TEST, next.depthTest);
+    if (changed(current.depthWrite != next.depthWrite))
+        glDepthMask(next.depthWrite ? GL_TRUE : GL_FALSE);
+    if (changed(current.depthFunc != next.depthFunc))
+        glDepthFunc(next.depthFunc);
+
+    if (changed(current.stencilTest != next.stencilTest))
+        setCapability(GL_STENCIL_TEST, next.stencilTest);
+    if (changed(current.stencilFunc != next.stencilFunc || current.stencilRef != next.stencilRef || current.stencilReadMask != next.stencilReadMask))
+        glStencilFunc(next.stencilFunc, next.stencilRef, next.stencilReadMask);
+    if (changed(current.stencilWriteMask != next.stencilWriteMask))
+        glStencilMask(next.stencilWriteMask);
+    if (changed(current.stencilFail != next.stencilFail || current.stencilDepthFail != next.stencilDepthFail || current.stencilPass != next.stencilPass))
+        glStencilOp(next.stencilFail, next.stencilDepthFail, next.stencilPass);
+
+    if (changed(current.blend != next.blend))
+        setCapability(GL_BLEND, next.blend);
+    if (changed(current.blendSrc != next.blendSrc || current.blendDst != next.blendDst))
+        glBlendFunc(next.blendSrc, next.blendDst);
+
+    if (changed(current.cullFace != next.cullFace))
+        setCapability(GL_CULL_FACE, next.cullFace);
+    if (changed(current.cullMode != next.cullMode))
+        glCullFace(next.cullMode);
+
+    if (changed(current.colorWrite != next.colorWrite)) {
+        GLboolean mask = next.colorWrite ? GL_TRUE : GL_FALSE;
+        glColorMask(mask, mask, mask, mask);
+    }
+
+    s_state.pipeline = next;
+    s_state.pipelineValid = true;
+}
+
+void Renderer::InvalidateStateCache() {
+    InvalidateBindings();
+    s_state.pipelineValid = false;
+}
+
+void Renderer::InvalidateBindings() {
+    s_state.program = s_unknown;
+    s_state.vao = s_unknown;
+    s_state.activeUnit = s_unknown;
+    for (int i = 0; i < s_maxTextureUnits; i++) {
+        s_state.textures2D[i] = s_unknown;
+        s_state.texturesBuffer[i] = s_unknown;
+    }
+}
+
+void Renderer::OnProgramDeleted(unsigned int program) {
+    if (s_state.program == program) s_state.program = s_unknown;
+}
+
+void Renderer::OnVertexArrayDeleted(unsigned int vao) {
+    if (s_state.vao == vao) s_state.vao = s_unknown;
+}
+
+void Renderer::OnTextureDeleted(unsigned int texture) {
+    for (int i = 0; i < s_maxTextureUnits; i++) {
+        if (s_state.textures2D[i] == texture) s_state.textures2D[i] = s_unknown;
+        if (s_state.texturesBuffer[i] == texture) s_state.texturesBuffer[i] = s_unknown;
+    }
 }
 
 void Renderer::ClearError() {
@@ -2,6 +2,7 @@
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
@@ -12,21 +13,135 @@
     x;\
     BREAKER(LogCall(#x, __FILE__, __LINE__));
 
+// Features of the context Initialize ended up with
+struct RendererCaps {
+    int glMajor = 0;
+    int glMinor = 0;
+    bool multiDrawIndirect = false; // glMultiDrawElementsIndirect with baseInstance
+    bool bufferStorage = false;     // persistently mapped buffers
+    bool pipelineStatistics = false; // GL_FRAGMENT_SHADER_INVOCATIONS_ARB queries
+    bool programBinary = false;      // glGetProgramBinary with at least one format
+    bool parallelShaderCompile = false; // GL_COMPLETION_STATUS_KHR polling
+    bool textureS3TC = false;        // BC1 and BC3 textures
+    bool textureBPTC = false;        // BC7 textures
+    int uniformBufferAlignment = 256;
+    int maxTextureBufferSize = 65536; // texels
+};
+
+class RingBuffer;
+
+// std140 layout of the CameraBlock uniform block
+struct CameraBlockData {
+    glm::mat4 view;
+    glm::mat4 proj;
+    glm::mat4 viewProj;
+    glm::vec4 position; // xyz
+};
+
+// Fixed-function state for a draw. Describe it once, wrap it in an immutable
+// PipelineState and let Renderer::ApplyPipelineState diff it against GL.
+struct PipelineStateDesc {
+    bool depthTest = true;
+    bool depthWrite = true;
+    GLenum depthFunc = GL_LESS;
+
+    bool stencilTest = false;
+    GLenum stencilFunc = GL_ALWAYS;
+    GLint stencilRef = 0;
+    GLuint stencilReadMask = 0xFF;
+    GLuint stencilWriteMask = 0xFF;
+    GLenum stencilFail = GL_KEEP;
+    GLenum stencilDepthFail = GL_KEEP;
+    GLenum stencilPass = GL_KEEP;
+
+    bool blend = false;
+    GLenum blendSrc = GL_ONE;
+    GLenum blendDst = GL_ZERO;
+
+    bool cullFace = false;
+    GLenum cullMode = GL_BACK;
+
+    bool colorWrite = true;
+};
+
+class PipelineState {
+public:
+    explicit PipelineState(const PipelineStateDesc& desc) : m_desc(desc) {}
+    const PipelineStateDesc& GetDesc() const { return m_desc; }
+
+private:
+    const PipelineStateDesc m_desc;
+};
+
 class Renderer {
 public:
     static bool Initialize();
     static void Cleanup();
     static GLFWwindow* GetWindow() { return s_window; }
+    static const RendererCaps& GetCaps() { return s_caps; }
     static void InitializeImGui();
     static void BeginImGuiFrame();
     static void EndImGuiFrame();
+
+    // Bracket each frame; per-frame data is streamed through the frame ring
+    static void BeginFrame();
+    static void EndFrame();
+    static RingBuffer& GetFrameRing() { return *s_frameRing; }
+
+    // Stream a view's camera into the frame ring and bind it as CameraBlock
+    // for every program; call once per view
+    static void SetCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position);
     
+    // State cache: shadows GL bindings and fixed-function state so redundant
+    // calls never reach the driver. Anything that binds programs, VAOs or
+    // textures should go through these.
+    static void UseProgram(unsigned int program);
+    static void BindVertexArray(unsigned int vao);
+    static void BindTexture(unsigned int unit, GLenum target, unsigned int texture);
+    // For glTexImage2D, glTexBuffer and the other calls that act on the
+    // texture bound to the active unit. A bind the cache elides also skips
+    // glActiveTexture, so BindTexture alone leaves another unit active.
+    static void BindTextureForUpdate(unsigned int unit, GLenum target, unsigned int texture);
+    static void ApplyPipelineState(const PipelineState& state);
+
+    // Forget the shadowed state, e.g. after code that talks to GL directly
+    static void InvalidateStateCache();
+    static void InvalidateBindings();
+
+    // Deleting a bound object silently resets the GL binding
+    static void OnProgramDeleted(unsigned int program);
+    static void OnVertexArrayDeleted(unsigned int vao);
+    static void OnTextureDeleted(unsigned int texture);
+
+    static void ResetStateCounters() { s_issuedCalls = 0; s_elidedCalls = 0; }
+    static int GetIssuedCallCount() { return s_issuedCalls; }
+    static int GetElidedCallCount() { return s_elidedCalls; }
+
     // Error handling
     static void ClearError();
     static bool LogCall(const char* function, const char* file, int line);
 
 private:
     static GLFWwindow* s_window;
+    static RendererCaps s_caps;
+    static RingBuffer* s_frameRing;
+
+    static const int s_maxTextureUnits = 16;
+    static const unsigned int s_unknown = ~0u;
+    struct StateShadow {
+        unsigned int program = s_unknown;
+        unsigned int vao = s_unknown;
+        unsigned int activeUnit = s_unknown;
+        unsigned int textures2D[s_maxTextureUnits];
+        unsigned int texturesBuffer[s_maxTextureUnits];
+        bool pipelineValid = false;
+        PipelineStateDesc pipeline;
+    };
+    static StateShadow s_state;
+    static int s_issuedCalls;
+    static int s_elidedCalls;
+
+    static void SetActiveTextureUnit(unsigned int unit);
     static const int s_windowWidth = 1920;
     static const int s_windowHeight = 1080;
 };
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "RingBuffer.h"
+#include "Renderer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+    // Regions keep offsets aligned for every use in the engine: draw data (144
+    // bytes), texel fetches (16) and indirect commands (4)
+    const size_t REGION_GRANULARITY = 2304;
+
+    const GLbitfield PERSISTENT_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+}
+
+RingBuffer::RingBuffer(size_t regionSize, size_t maxSize)
+    : m_buffer(0), m_generation(0),
+      m_regionSize((regionSize + REGION_GRANULARITY - 1) / REGION_GRANULARITY * REGION_GRANULARITY),
+      m_maxRegionSize(std::max(maxSize / REGION_COUNT / REGION_GRANULARITY, size_t(1)) * REGION_GRANULARITY),
+      m_limitReported(false),
+      m_persistent(Renderer::GetCaps().bufferStorage),
+      m_mapped(nullptr),
+      m_region(0), m_head(0), m_frameBytes(0), m_stallCount(0)
+{
+    std::fill(m_fences, m_fences + REGION_COUNT, (GLsync)0);
+    m_regionSize = std::min(m_regionSize, m_maxRegionSize);
+    Create();
+}
+
+RingBuffer::~RingBuffer() {
+    Destroy();
+}
+
+void RingBuffer::Create() {
+    glGenBuffers(1, &m_buffer);
+    m_generation++;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+
+    if (m_persistent) {
+        glBufferStorage(GL_COPY_WRITE_BUFFER, GetSize(), nullptr, PERSISTENT_FLAGS);
+        m_mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, GetSize(), PERSISTENT_FLAGS));
+        if (!m_mapped) {
+            std::cerr << "RingBuffer: persistent mapping failed, using glMapBufferRange" << std::endl;
+            glDeleteBuffers(1, &m_buffer);
+            m_persistent = false;
+            Create();
+            return;
+        }
+    }
+    else {
+        glBufferData(GL_COPY_WRITE_BUFFER, GetSize(), nullptr, GL_STREAM_DRAW);
+    }
+}
+
+void RingBuffer::Retire() {
+    for (GLsync& fence : m_fences) {
+        if (fence) glDeleteSync(fence);
+        fence = 0;
+    }
+    if (m_mapped) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        m_mapped = nullptr;
+    }
+    // Deleting now would unbind it everywhere, dropping ranges bound earlier
+    // this frame (the camera block) and possibly lending its name to the
+    // replacement
+    m_retired.push_back(m_buffer);
+    m_buffer = 0;
+}
+
+void RingBuffer::Destroy() {
+    Retire();
+    // GL keeps the storage alive for draws already issued from it
+    glDeleteBuffers(static_cast<GLsizei>(m_retired.size()), m_retired.data());
+    m_retired.clear();
+}
+
+void RingBuffer::BeginFrame() {
+    if (!m_retired.empty()) {
+        glDeleteBuffers(static_cast<GLsizei>(m_retired.size()), m_retired.data());
+        m_retired.clear();
+    }
+
+    m_region = (m_region + 1) % REGION_COUNT;
+    m_head = m_region * m_regionSize;
+    m_frameBytes = 0;
+
+    GLsync& fence = m_fences[m_region];
+    if (!fence) return;
+
+    // Normally signalled long ago; waiting here means the GPU is three frames behind
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        m_stallCount++;
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fence = 0;
+}
+
+void RingBuffer::EndFrame() {
+    GLsync& fence = m_fences[m_region];
+    if (fence) glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+size_t RingBuffer::AlignedHead(size_t alignment) const {
+    return (m_head + alignment - 1) / alignment * alignment;
+}
+
+bool RingBuffer::Reserve(size_t size) {
+    if (m_head + size <= RegionEnd()) return true;
+
+    // Whatever this frame already wrote stays in the old buffer, which GL
+    // frees once the draws reading it are done
+    size_t used = m_head - m_region * m_regionSize;
+    size_t needed = (used + size + REGION_GRANULARITY - 1) / REGION_GRANULARITY * REGION_GRANULARITY;
+    if (needed > m_maxRegionSize) {
+        if (!m_limitReported) {
+            std::cerr << "RingBuffer: a frame needs " << needed / 1024 << " KB, over the "
+                      << m_maxRegionSize / 1024 << " KB region limit; dropping writes" << std::endl;
+            m_limitReported = true;
+        }
+        return false;
+    }
+    size_t regionSize = std::min(std::max(m_regionSize * 2, needed), m_maxRegionSize);
+    std::cout << "RingBuffer: growing regions to " << regionSize / 1024 << " KB" << std::endl;
+
+    Retire();
+    m_regionSize = regionSize;
+    Create();
+    m_head = m_region * m_regionSize;
+    return true;
+}
+
+size_t RingBuffer::Write(const void* data, size_t size, size_t alignment) {
+    if (AlignedHead(alignment) + size > RegionEnd() && !Reserve(size + alignment)) {
+        return INVALID_OFFSET;
+    }
+
+    size_t offset = AlignedHead(alignment);
+    if (m_persistent) {
+        std::memcpy(m_mapped + offset, data, size);
+    }
+    else if (size > 0) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+        void* target = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        std::memcpy(target, data, size);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+
+    m_frameBytes += offset + size - m_head;
+    m_head = offset + size;
+    return offset;
+}
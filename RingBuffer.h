@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+
+// Triple-buffered stream buffer for data that lives for one frame. Each frame
+// writes into its own region, and a fence placed at the end of the frame
+// keeps the region from being reused until the GPU has finished reading it,
+// so writes never stall on, or race with, draws still in flight. With
+// ARB_buffer_storage the buffer is persistently and coherently mapped and a
+// write is a plain memcpy; otherwise each write maps its range with
+// UNSYNCHRONIZED | INVALIDATE_RANGE, which the fences make safe.
+class RingBuffer {
+public:
+    static const int REGION_COUNT = 3;
+    static const size_t INVALID_OFFSET = ~size_t(0);
+
+    // maxSize bounds the whole buffer, regions included, however far it grows
+    explicit RingBuffer(size_t regionSize, size_t maxSize = ~size_t(0));
+    ~RingBuffer();
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    // Move on to the next region; blocks only if the GPU is REGION_COUNT frames behind
+    void BeginFrame();
+    // Fence the region written this frame
+    void EndFrame();
+
+    // Make sure size bytes, plus alignment padding, fit in this frame's region.
+    // Growing replaces the buffer, so callers that need several writes in the
+    // same buffer reserve their total first. The old buffer stays alive, with
+    // its bindings, until the next BeginFrame. Returns false, reporting once,
+    // if the region would have to outgrow maxSize.
+    bool Reserve(size_t size);
+
+    // Copy data into this frame's region at a multiple of alignment (which need
+    // not be a power of two) and return its byte offset in the buffer, or
+    // INVALID_OFFSET if it cannot fit. The data stays valid until the end of
+    // the frame.
+    size_t Write(const void* data, size_t size, size_t alignment = 16);
+
+    // May change after Reserve or Write when the buffer grows. A new buffer
+    // can reuse a deleted one's name, so compare generations, not IDs, to
+    // tell whether views of the buffer need respecifying.
+    unsigned int GetID() const { return m_buffer; }
+    unsigned int GetGeneration() const { return m_generation; }
+    size_t GetSize() const { return m_regionSize * REGION_COUNT; }
+    bool IsPersistent() const { return m_persistent; }
+
+    // Statistics
+    size_t GetFrameBytes() const { return m_frameBytes; }
+    int GetStallCount() const { return m_stallCount; }
+
+private:
+    unsigned int m_buffer;
+    unsigned int m_generation;
+    std::vector<unsigned int> m_retired; // replaced this frame, deleted at the next BeginFrame
+    size_t m_regionSize;
+    size_t m_maxRegionSize;
+    bool m_limitReported;
+    bool m_persistent;
+    unsigned char* m_mapped;
+    GLsync m_fences[REGION_COUNT];
+
+    int m_region;
+    size_t m_head;  // next free byte, relative to the buffer start
+    size_t m_frameBytes;
+    int m_stallCount;
+
+    void Create();
+    void Retire();
+    void Destroy();
+    size_t AlignedHead(size_t alignment) const;
+    size_t RegionEnd() const { return (m_region + 1) * m_regionSize; }
+};
@@ -0,0 +1,219 @@
+#include "SceneOctree.h"
+#include <algorithm>
+
+SceneOctree::SceneOctree(const glm::vec3& center, float halfSize, int maxDepth)
+    : m_maxDepth(maxDepth)
+{
+    AllocateNode(center, halfSize, 0, -1);
+}
+
+int SceneOctree::AllocateNode(const glm::vec3& center, float halfSize, int depth, int parent) {
+    int index;
+    if (!m_freeNodes.empty()) {
+        index = m_freeNodes.back();
+        m_freeNodes.pop_back();
+    }
+    else {
+        index = static_cast<int>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+
+    Node& node = m_nodes[index];
+    node.center = center;
+    node.halfSize = halfSize;
+    node.depth = depth;
+    node.parent = parent;
+    std::fill(node.children, node.children + 8, -1);
+    node.subtreeCount = 0;
+    return index;
+}
+
+void SceneOctree::FreeSubtree(int index) {
+    Node& node = m_nodes[index];
+    for (int child : node.children) {
+        if (child >= 0) FreeSubtree(child);
+    }
+    node.bounds.Clear();
+    node.handles.clear();
+    m_freeNodes.push_back(index);
+}
+
+int SceneOctree::FindNode(const glm::vec3& center, const glm::vec3& extent) {
+    const Node& root = m_nodes[ROOT_NODE];
+    glm::vec3 offset = glm::abs(center - root.center);
+    float size = std::max(extent.x, std::max(extent.y, extent.z));
+    if (offset.x > root.halfSize || offset.y > root.halfSize || offset.z > root.halfSize || size > root.halfSize) {
+        return OVERFLOW_NODE;
+    }
+
+    // Descend while the object still fits a child's loose bounds
+    int index = ROOT_NODE;
+    while (m_nodes[index].depth < m_maxDepth) {
+        float childHalf = m_nodes[index].halfSize * 0.5f;
+        if (size > childHalf) break;
+
+        const glm::vec3 nodeCenter = m_nodes[index].center;
+        int octant = (center.x >= nodeCenter.x ? 1 : 0)
+                   | (center.y >= nodeCenter.y ? 2 : 0)
+                   | (center.z >= nodeCenter.z ? 4 : 0);
+
+        int child = m_nodes[index].children[octant];
+        if (child < 0) {
+            glm::vec3 childCenter = nodeCenter + glm::vec3(
+                (octant & 1) ? childHalf : -childHalf,
+                (octant & 2) ? childHalf : -childHalf,
+                (octant & 4) ? childHalf : -childHalf);
+            child = AllocateNode(childCenter, childHalf, m_nodes[index].depth + 1, index);
+            m_nodes[index].children[octant] = child;
+        }
+        index = child;
+    }
+    return index;
+}
+
+void SceneOctree::Attach(SceneHandle handle, int index) {
+    Object& object = m_objects[handle];
+    Node& node = NodeAt(index);
+    object.node = index;
+    object.slot = static_cast<uint32_t>(node.handles.size());
+    node.handles.push_back(handle);
+    node.bounds.Add(object.center, object.extent);
+
+    for (int i = index; i >= 0; i = m_nodes[i].parent) {
+        m_nodes[i].subtreeCount++;
+    }
+}
+
+void SceneOctree::Detach(int index, uint32_t slot) {
+    Node& node = NodeAt(index);
+
+    // Swap-remove; during a move the object itself may be the last entry
+    uint32_t last = static_cast<uint32_t>(node.handles.size() - 1);
+    if (slot != last) {
+        SceneHandle moved = node.handles[last];
+        node.handles[slot] = moved;
+        m_objects[moved].slot = slot;
+    }
+    node.handles.pop_back();
+    node.bounds.RemoveSwap(slot);
+
+    if (index == OVERFLOW_NODE) return;
+
+    // Unlink the highest ancestor left empty, so the tree does not keep dead branches
+    int emptied = -1;
+    for (int i = index; i >= 0; i = m_nodes[i].parent) {
+        if (--m_nodes[i].subtreeCount == 0 && i != ROOT_NODE) emptied = i;
+    }
+    if (emptied >= 0) {
+        int* children = m_nodes[m_nodes[emptied].parent].children;
+        *std::find(children, children + 8, emptied) = -1;
+        FreeSubtree(emptied);
+    }
+}
+
+SceneHandle SceneOctree::Insert(const glm::vec3& center, const glm::vec3& extent, uint32_t userData) {
+    SceneHandle handle;
+    if (!m_freeHandles.empty()) {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+    }
+    else {
+        handle = static_cast<SceneHandle>(m_objects.size());
+        m_objects.emplace_back();
+    }
+
+    Object& object = m_objects[handle];
+    object.center = center;
+    object.extent = extent;
+    object.userData = userData;
+    Attach(handle, FindNode(center, extent));
+    m_objectCount++;
+    return handle;
+}
+
+void SceneOctree::Remove(SceneHandle handle) {
+    Detach(m_objects[handle].node, m_objects[handle].slot);
+    m_freeHandles.push_back(handle);
+    m_objectCount--;
+}
+
+void SceneOctree::Move(SceneHandle handle, const glm::vec3& center, const glm::vec3& extent) {
+    Object& object = m_objects[handle];
+    object.center = center;
+    object.extent = extent;
+
+    int index = FindNode(center, extent);
+    if (index == object.node) {
+        NodeAt(index).bounds.Set(object.slot, center, extent);
+        return;
+    }
+
+    // FindNode may have created the new node's path; attaching first keeps
+    // the detach from pruning it while it is still empty
+    int oldNode = object.node;
+    uint32_t oldSlot = object.slot;
+    Attach(handle, index);
+    Detach(oldNode, oldSlot);
+}
+
+void SceneOctree::Clear() {
+    glm::vec3 center = m_nodes[ROOT_NODE].center;
+    float halfSize = m_nodes[ROOT_NODE].halfSize;
+
+    m_nodes.clear();
+    m_freeNodes.clear();
+    m_overflow.bounds.Clear();
+    m_overflow.handles.clear();
+    m_objects.clear();
+    m_freeHandles.clear();
+    m_objectCount = 0;
+
+    AllocateNode(center, halfSize, 0, -1);
+}
+
+void SceneOctree::AppendObjects(const Node& node, const Frustum& frustum, bool inside, std::vector<SceneHandle>& visible) const {
+    if (inside) {
+        visible.insert(visible.end(), node.handles.begin(), node.handles.end());
+        return;
+    }
+
+    m_objectsTested += static_cast<int>(node.handles.size());
+    frustum.CullBoxes(node.bounds, m_survivors);
+    for (uint32_t index : m_survivors) {
+        visible.push_back(node.handles[index]);
+    }
+}
+
+void SceneOctree::Query(const Frustum& frustum, std::vector<SceneHandle>& visible) const {
+    visible.clear();
+    m_nodesVisited = 0;
+    m_objectsTested = 0;
+
+    AppendObjects(m_overflow, frustum, false, visible);
+
+    m_stack.clear();
+    m_stack.emplace_back(static_cast<int>(ROOT_NODE), false);
+    while (!m_stack.empty()) {
+        int index = m_stack.back().first;
+        bool inside = m_stack.back().second;
+        m_stack.pop_back();
+
+        const Node& node = m_nodes[index];
+        if (node.subtreeCount == 0) continue;
+        m_nodesVisited++;
+
+        // Once a node is inside the frustum, everything below it is too
+        if (!inside) {
+            FrustumTest test = frustum.ClassifyBox(node.center, glm::vec3(node.halfSize * 2.0f));
+            if (test == FrustumTest::Outside) continue;
+            inside = test == FrustumTest::Inside;
+        }
+
+        if (!node.handles.empty()) {
+            AppendObjects(node, frustum, inside, visible);
+        }
+        for (int child : node.children) {
+            if (child >= 0) m_stack.emplace_back(child, inside);
+        }
+    }
+}
\ No newline at end of file
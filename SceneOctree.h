@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Frustum.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using SceneHandle = uint32_t;
+const SceneHandle INVALID_SCENE_HANDLE = ~0u;
+
+// Loose octree over object bounding boxes. A node's bounds are its cell grown
+// to twice the size, so an object lives in the deepest node whose cell holds
+// its centre and whose half size is at least the object's largest extent.
+// Objects never straddle nodes, and small moves usually stay in the same node.
+//
+// Frustum queries reject subtrees outside the frustum, accept subtrees fully
+// inside without testing anything below them, and cull the objects of
+// partially visible nodes with the SIMD box kernel. Objects centred outside
+// the root cell, or bigger than it, go to an overflow list tested every query.
+class SceneOctree {
+public:
+    SceneOctree(const glm::vec3& center, float halfSize, int maxDepth = 8);
+
+    SceneOctree(const SceneOctree&) = delete;
+    SceneOctree& operator=(const SceneOctree&) = delete;
+
+    SceneHandle Insert(const glm::vec3& center, const glm::vec3& extent, uint32_t userData);
+    void Remove(SceneHandle handle);
+    void Move(SceneHandle handle, const glm::vec3& center, const glm::vec3& extent);
+    void Clear();
+
+    uint32_t GetUserData(SceneHandle handle) const { return m_objects[handle].userData; }
+
+    // Replace visible with the handles of the objects that touch the frustum
+    void Query(const Frustum& frustum, std::vector<SceneHandle>& visible) const;
+
+    int GetObjectCount() const { return m_objectCount; }
+    int GetNodeCount() const { return static_cast<int>(m_nodes.size() - m_freeNodes.size()); }
+
+    // Work done by the last query
+    int GetNodesVisited() const { return m_nodesVisited; }
+    int GetObjectsTested() const { return m_objectsTested; }
+
+private:
+    static const int OVERFLOW_NODE = -1;
+    static const int ROOT_NODE = 0;
+
+    struct Node {
+        glm::vec3 center = glm::vec3(0.0f);
+        float halfSize = 0.0f;
+        int depth = 0;
+        int parent = -1;
+        int children[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+        int subtreeCount = 0; // objects in this node and below
+
+        BoxBounds bounds;
+        std::vector<SceneHandle> handles;
+    };
+
+    struct Object {
+        glm::vec3 center = glm::vec3(0.0f);
+        glm::vec3 extent = glm::vec3(0.0f);
+        uint32_t userData = 0;
+        int node = OVERFLOW_NODE;
+        uint32_t slot = 0; // index in the node's arrays
+    };
+
+    std::vector<Node> m_nodes;
+    std::vector<int> m_freeNodes;
+    Node m_overflow;
+
+    std::vector<Object> m_objects;
+    std::vector<SceneHandle> m_freeHandles;
+    int m_objectCount = 0;
+    int m_maxDepth;
+
+    // Query scratch and statistics
+    mutable std::vector<std::pair<int, bool>> m_stack;
+    mutable std::vector<uint32_t> m_survivors;
+    mutable int m_nodesVisited = 0;
+    mutable int m_objectsTested = 0;
+
+    Node& NodeAt(int index) { return index == OVERFLOW_NODE ? m_overflow : m_nodes[index]; }
+
+    int FindNode(const glm::vec3& center, const glm::vec3& extent);
+    int AllocateNode(const glm::vec3& center, float halfSize, int depth, int parent);
+    void FreeSubtree(int index);
+
+    void Attach(SceneHandle handle, int node);
+    void Detach(int node, uint32_t slot);
+
+    void AppendObjects(const Node& node, const Frustum& frustum, bool inside, std::vector<SceneHandle>& visible) const;
+};
\ No newline at end of file
@@ -1,66 +1,285 @@
 #include "Shader.h"
+#include "Renderer.h"
+#include "ProgramBinaryCache.h"
+#include <algorithm>
+#include <cstring>
 
-Shader::Shader(const std::string& filepath) : m_program(0) {
+ShaderDefines& ShaderDefines::Set(const std::string& name, int value) {
+    m_values[name] = value;
+    return *this;
+}
+
+std::string ShaderDefines::GetKey() const {
+    std::string key;
+    for (const auto& define : m_values) {
+        key += define.first + "=" + std::to_string(define.second) + ";";
+    }
+    return key;
+}
+
+std::string ShaderDefines::GetPreamble() const {
+    std::string preamble;
+    for (const auto& define : m_values) {
+        preamble += "#define " + define.first + " " + std::to_string(define.second) + "\n";
+    }
+    return preamble;
+}
+
+Shader::Shader(const std::string& filepath, const ShaderDefines& defines)
+    : m_filepath(filepath), m_program(0), m_vertexShader(0), m_fragmentShader(0), m_building(false),
+      m_loadMs(0.0), m_fromBinaryCache(false), m_cacheKey(0),
+      m_buildStart(std::chrono::steady_clock::now())
+{
     ShaderProgramSource source = ParseShader(filepath);
-    m_program = CreateShaderProgram(source.vertexShaderSource, source.fragmentShaderSource);
+    if (!defines.IsEmpty()) {
+        std::string preamble = defines.GetPreamble();
+        InjectDefines(source.vertexShaderSource, preamble);
+        InjectDefines(source.fragmentShaderSource, preamble);
+    }
+    StartBuild(source.vertexShaderSource, source.fragmentShaderSource);
 }
 
 Shader::~Shader() {
+    if (m_building) {
+        glDeleteShader(m_vertexShader);
+        glDeleteShader(m_fragmentShader);
+    }
     if (m_program != 0) {
         glDeleteProgram(m_program);
+        Renderer::OnProgramDeleted(m_program);
     }
 }
 
 void Shader::Use() const {
-    glUseProgram(m_program);
+    Wait();
+    Renderer::UseProgram(m_program);
+}
+
+bool Shader::IsReady() const {
+    if (!m_building) return true;
+    if (Renderer::GetCaps().parallelShaderCompile) {
+        int done = GL_FALSE;
+        glGetProgramiv(m_program, GL_COMPLETION_STATUS_KHR, &done);
+        if (done == GL_FALSE) return false;
+    }
+    FinishBuild();
+    return true;
+}
+
+namespace {
+
+    bool IsSampler(GLenum type) {
+        switch (type) {
+        case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_BUFFER:
+        case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_BUFFER:
+        case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // glUniform1i sets bools, ints and sampler units alike
+    bool IsCompatible(GLenum requested, GLenum actual) {
+        if (requested == actual) return true;
+        if (requested == GL_INT || requested == GL_BOOL) {
+            return actual == GL_INT || actual == GL_BOOL || IsSampler(actual);
+        }
+        return false;
+    }
+
+}
+
+int Shader::Resolve(uint32_t hash, const char* name, GLenum type) const {
+    Wait();
+    auto it = std::lower_bound(m_uniforms.begin(), m_uniforms.end(), hash,
+        [](const UniformEntry& entry, uint32_t value) { return entry.hash < value; });
+    bool found = it != m_uniforms.end() && it->hash == hash;
+    if (found && IsCompatible(type, it->type)) {
+        return static_cast<int>(it - m_uniforms.begin());
+    }
+
+    // Report once; inactive uniforms land here too, since the linker dropped them
+    if (m_program != 0 && std::find(m_reported.begin(), m_reported.end(), hash) == m_reported.end()) {
+        m_reported.push_back(hash);
+        std::cerr << "Shader: ";
+        if (name) std::cerr << "'" << name << "'";
+        else std::cerr << "uniform #" << std::hex << hash << std::dec;
+        std::cerr << (found ? " has a different type in " : " is not an active uniform of ") << m_filepath << std::endl;
+    }
+    return -1;
+}
+
+int Shader::s_issuedUniforms = 0;
+int Shader::s_skippedUniforms = 0;
+
+template <typename T>
+bool Shader::Changed(int index, const T& value) const {
+    static_assert(sizeof(T) <= sizeof(UniformShadow::value), "Uniform shadow too small");
+    UniformShadow& shadow = m_shadows[m_uniforms[index].slot];
+    if (shadow.valid && std::memcmp(shadow.value, &value, sizeof(T)) == 0) {
+        s_skippedUniforms++;
+        return false;
+    }
+    std::memcpy(shadow.value, &value, sizeof(T));
+    shadow.valid = true;
+    s_issuedUniforms++;
+    return true;
+}
+
+void Shader::Set(Uniform<bool> uniform, bool value) const {
+    int asInt = value ? 1 : 0;
+    if (uniform.IsValid() && Changed(uniform.index, asInt)) glUniform1i(m_uniforms[uniform.index].location, asInt);
+}
+
+void Shader::Set(Uniform<int> uniform, int value) const {
+    if (uniform.IsValid() && Changed(uniform.index, value)) glUniform1i(m_uniforms[uniform.index].location, value);
+}
+
+void Shader::Set(Uniform<float> uniform, float value) const {
+    if (uniform.IsValid() && Changed(uniform.index, value)) glUniform1f(m_uniforms[uniform.index].location, value);
+}
+
+void Shader::Set(Uniform<glm::vec2> uniform, const glm::vec2& value) const {
+    if (uniform.IsValid() && Changed(uniform.index, value)) glUniform2fv(m_uniforms[uniform.index].location, 1, &value[0]);
+}
+
+void Shader::Set(Uniform<glm::vec3> uniform, const glm::vec3& value) const {
+    if (uniform.IsValid() && Changed(uniform.index, value)) glUniform3fv(m_uniforms[uniform.index].location, 1, &value[0]);
+}
+
+void Shader::Set(Uniform<glm::vec4> uniform, const glm::vec4& value) const {
+    if (uniform.IsValid() && Changed(uniform.index, value)) glUniform4fv(m_uniforms[uniform.index].location, 1, &value[0]);
+}
+
+void Shader::Set(Uniform<glm::mat2> uniform, const glm::mat2& value) const {
+    if (uniform.IsValid() && Changed(uniform.index, value)) glUniformMatrix2fv(m_uniforms[uniform.index].location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::Set(Uniform<glm::mat3> uniform, const glm::mat3& value) const {
+    if (uniform.IsValid() && Changed(uniform.index, value)) glUniformMatrix3fv(m_uniforms[uniform.index].location, 1, GL_FALSE, &value[0][0]);
 }
 
-void Shader::SetBool(const std::string& name, bool value) const {
-    glUniform1i(glGetUniformLocation(m_program, name.c_str()), (int)value);
+void Shader::Set(Uniform<glm::mat4> uniform, const glm::mat4& value) const {
+    if (uniform.IsValid() && Changed(uniform.index, value)) glUniformMatrix4fv(m_uniforms[uniform.index].location, 1, GL_FALSE, &value[0][0]);
 }
 
-void Shader::SetInt(const std::string& name, int value) const {
-    glUniform1i(glGetUniformLocation(m_program, name.c_str()), value);
+void Shader::SetBool(const char* name, bool value) const {
+    Set(GetUniform<bool>(name), value);
 }
 
-void Shader::SetFloat(const std::string& name, float value) const {
-    glUniform1f(glGetUniformLocation(m_program, name.c_str()), value);
+void Shader::SetInt(const char* name, int value) const {
+    Set(GetUniform<int>(name), value);
 }
 
-void Shader::SetVec2(const std::string& name, const glm::vec2& value) const {
-    glUniform2fv(glGetUniformLocation(m_program, name.c_str()), 1, &value[0]);
+void Shader::SetFloat(const char* name, float value) const {
+    Set(GetUniform<float>(name), value);
 }
 
-void Shader::SetVec2(const std::string& name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(m_program, name.c_str()), x, y);
+void Shader::SetVec2(const char* name, const glm::vec2& value) const {
+    Set(GetUniform<glm::vec2>(name), value);
 }
 
-void Shader::SetVec3(const std::string& name, const glm::vec3& value) const {
-    glUniform3fv(glGetUniformLocation(m_program, name.c_str()), 1, &value[0]);
+void Shader::SetVec2(const char* name, float x, float y) const {
+    Set(GetUniform<glm::vec2>(name), glm::vec2(x, y));
 }
 
-void Shader::SetVec3(const std::string& name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(m_program, name.c_str()), x, y, z);
+void Shader::SetVec3(const char* name, const glm::vec3& value) const {
+    Set(GetUniform<glm::vec3>(name), value);
 }
 
-void Shader::SetVec4(const std::string& name, const glm::vec4& value) const {
-    glUniform4fv(glGetUniformLocation(m_program, name.c_str()), 1, &value[0]);
+void Shader::SetVec3(const char* name, float x, float y, float z) const {
+    Set(GetUniform<glm::vec3>(name), glm::vec3(x, y, z));
 }
 
-void Shader::SetVec4(const std::string& name, float x, float y, float z, float w) const {
-    glUniform4f(glGetUniformLocation(m_program, name.c_str()), x, y, z, w);
+void Shader::SetVec4(const char* name, const glm::vec4& value) const {
+    Set(GetUniform<glm::vec4>(name), value);
 }
 
-void Shader::SetMatrix2(const std::string& name, const glm::mat2& mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(m_program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+void Shader::SetVec4(const char* name, float x, float y, float z, float w) const {
+    Set(GetUniform<glm::vec4>(name), glm::vec4(x, y, z, w));
 }
 
-void Shader::SetMatrix3(const std::string& name, const glm::mat3& mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(m_program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+void Shader::SetMatrix2(const char* name, const glm::mat2& mat) const {
+    Set(GetUniform<glm::mat2>(name), mat);
+}
+
+void Shader::SetMatrix3(const char* name, const glm::mat3& mat) const {
+    Set(GetUniform<glm::mat3>(name), mat);
+}
+
+void Shader::SetMatrix4(const char* name, const glm::mat4& mat) const {
+    Set(GetUniform<glm::mat4>(name), mat);
+}
+
+void Shader::ReflectUniforms() const {
+    m_uniforms.clear();
+    uint32_t slots = 0;
+    int count = 0;
+    int maxLength = 0;
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> buffer(maxLength + 1);
+
+    for (int i = 0; i < count; i++) {
+        GLint size = 0;
+        GLenum type = 0;
+        GLsizei length = 0;
+        glGetActiveUniform(m_program, i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+        std::string name(buffer.data(), length);
+        GLint location = glGetUniformLocation(m_program, name.c_str());
+        if (location < 0) continue; // a member of a uniform block
+
+        // Arrays are reported as "name[0]"
+        size_t bracket = name.size() >= 3 ? name.size() - 3 : std::string::npos;
+        if (bracket != std::string::npos && name.compare(bracket, 3, "[0]") == 0) {
+            name.resize(bracket);
+            m_uniforms.push_back({ UniformHash(name.c_str()), location, type, slots });
+            for (int element = 0; element < size; element++) {
+                std::string elementName = name + "[" + std::to_string(element) + "]";
+                m_uniforms.push_back({ UniformHash(elementName.c_str()), glGetUniformLocation(m_program, elementName.c_str()), type, slots++ });
+            }
+        }
+        else {
+            m_uniforms.push_back({ UniformHash(name.c_str()), location, type, slots++ });
+        }
+    }
+    // A fresh link resets every uniform to zero, which the shadow does not assume
+    m_shadows.assign(slots, UniformShadow());
+
+    std::sort(m_uniforms.begin(), m_uniforms.end(),
+        [](const UniformEntry& a, const UniformEntry& b) { return a.hash < b.hash; });
+    for (size_t i = 1; i < m_uniforms.size(); i++) {
+        if (m_uniforms[i].hash == m_uniforms[i - 1].hash) {
+            std::cerr << "Shader: two uniforms of " << m_filepath << " share hash #" << std::hex << m_uniforms[i].hash << std::dec << std::endl;
+        }
+    }
 }
 
-void Shader::SetMatrix4(const std::string& name, const glm::mat4& mat) const { 
-    glUniformMatrix4fv(glGetUniformLocation(m_program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+void Shader::BindUniformBlocks() const {
+    const struct { const char* name; UniformBlockBinding binding; } blocks[] = {
+        { "CameraBlock", CAMERA_BLOCK_BINDING },
+        { "LightBlock", LIGHT_BLOCK_BINDING },
+        { "ClusterBlock", CLUSTER_BLOCK_BINDING }
+    };
+
+    int count = 0;
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    for (int i = 0; i < count; i++) {
+        char name[64];
+        glGetActiveUniformBlockName(m_program, i, sizeof(name), nullptr, name);
+        bool bound = false;
+        for (auto& block : blocks) {
+            if (std::strcmp(name, block.name) == 0) {
+                glUniformBlockBinding(m_program, i, block.binding);
+                bound = true;
+            }
+        }
+        if (!bound) {
+            std::cerr << "Shader: uniform block " << name << " of " << m_filepath << " has no fixed binding" << std::endl;
+        }
+    }
 }
 
 ShaderProgramSource Shader::ParseShader(const std::string& filepath) {
@@ -91,61 +310,109 @@ ShaderProgramSource Shader::ParseShader(const std::string& filepath) {
     return { ss[0].str(), ss[1].str() };
 }
 
+void Shader::InjectDefines(std::string& source, const std::string& preamble) {
+    // #version must stay the first directive, so the defines go after it. The
+    // #line keeps compiler messages pointing at the lines of the file section.
+    size_t version = source.find("#version");
+    if (version == std::string::npos) {
+        source = preamble + source;
+        return;
+    }
+    size_t lineEnd = source.find('\n', version);
+    if (lineEnd == std::string::npos) {
+        lineEnd = source.size();
+        source += "\n";
+    }
+    size_t insertAt = lineEnd + 1;
+    size_t nextLine = std::count(source.begin(), source.begin() + insertAt, '\n') + 1;
+    source.insert(insertAt, preamble + "#line " + std::to_string(nextLine) + "\n");
+}
+
+// Submit only; any status query here would wait for the compile
 unsigned int Shader::CompileShader(unsigned int type, const std::string& source) {
     unsigned int id = glCreateShader(type);
     const char* src = source.c_str();
     glShaderSource(id, 1, &src, nullptr);
     glCompileShader(id);
+    return id;
+}
 
-    // Error handling
+bool Shader::CheckCompile(unsigned int shader, unsigned int type) {
     int result;
-    glGetShaderiv(id, GL_COMPILE_STATUS, &result);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
     if (result == GL_FALSE) {
         int length;
-        glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
         char* message = new char[length];
-        glGetShaderInfoLog(id, length, &length, message);
+        glGetShaderInfoLog(shader, length, &length, message);
         std::cerr << "Failed to compile "
             << (type == GL_VERTEX_SHADER ? "vertex" : "fragment")
             << " shader!\n" << message << std::endl;
         delete[] message;
-        glDeleteShader(id);
-        return 0;
+        return false;
     }
-    return id;
+    return true;
 }
 
-unsigned int Shader::CreateShaderProgram(const std::string& vertexShader, const std::string& fragmentShader) {
-    unsigned int program = glCreateProgram();
-    unsigned int vs = CompileShader(GL_VERTEX_SHADER, vertexShader);
-    unsigned int fs = CompileShader(GL_FRAGMENT_SHADER, fragmentShader);
+void Shader::StartBuild(const std::string& vertexShader, const std::string& fragmentShader) {
+    // Uniform block bindings are set after linking, so a cached binary needs them again
+    if (ProgramBinaryCache::IsEnabled()) {
+        m_cacheKey = ProgramBinaryCache::Key(vertexShader, fragmentShader);
+        unsigned int cached = ProgramBinaryCache::Load(m_cacheKey);
+        if (cached != 0) {
+            m_program = cached;
+            BindUniformBlocks();
+            ReflectUniforms();
+            m_fromBinaryCache = true;
+            m_loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_buildStart).count();
+            return;
+        }
+    }
 
-    if (vs == 0 || fs == 0) {
-        glDeleteProgram(program);
-        return 0;
+    // Link straight after the compiles; a failed compile shows up as a failed link
+    m_program = glCreateProgram();
+    m_vertexShader = CompileShader(GL_VERTEX_SHADER, vertexShader);
+    m_fragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentShader);
+    glAttachShader(m_program, m_vertexShader);
+    glAttachShader(m_program, m_fragmentShader);
+    if (ProgramBinaryCache::IsEnabled()) {
+        glProgramParameteri(m_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     }
+    glLinkProgram(m_program);
+    m_building = true;
+}
+
+void Shader::FinishBuild() const {
+    m_building = false;
 
-    glAttachShader(program, vs);
-    glAttachShader(program, fs);
-    glLinkProgram(program);
+    bool compiled = CheckCompile(m_vertexShader, GL_VERTEX_SHADER);
+    compiled = CheckCompile(m_fragmentShader, GL_FRAGMENT_SHADER) && compiled;
 
     // Check for linking errors
-    int success;
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(program, 512, NULL, infoLog);
-        std::cerr << "Shader program linking failed:\n" << infoLog << std::endl;
-        glDeleteProgram(program);
-        glDeleteShader(vs);
-        glDeleteShader(fs);
-        return 0;
+    int success = GL_FALSE;
+    if (compiled) {
+        glGetProgramiv(m_program, GL_LINK_STATUS, &success);
+        if (!success) {
+            char infoLog[512];
+            glGetProgramInfoLog(m_program, 512, NULL, infoLog);
+            std::cerr << "Shader program linking failed:\n" << infoLog << std::endl;
+        }
     }
 
-    glValidateProgram(program);
-
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+    glDeleteShader(m_vertexShader);
+    glDeleteShader(m_fragmentShader);
+    m_vertexShader = m_fragmentShader = 0;
 
-    return program;
+    if (!success) {
+        glDeleteProgram(m_program);
+        m_program = 0;
+    }
+    else {
+        BindUniformBlocks();
+        ReflectUniforms();
+        if (ProgramBinaryCache::IsEnabled()) {
+            ProgramBinaryCache::Store(m_cacheKey, m_program);
+        }
+    }
+    m_loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_buildStart).count();
 }
\ No newline at end of file
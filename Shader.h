@@ -3,44 +3,183 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <chrono>
+#include <cstdint>
+#include <map>
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// Fixed binding points of the uniform blocks programs share; a program that
+// declares one of these blocks is bound to its point when it links
+enum UniformBlockBinding : unsigned int {
+    CAMERA_BLOCK_BINDING = 0,
+    LIGHT_BLOCK_BINDING = 1,
+    CLUSTER_BLOCK_BINDING = 2
+};
+
+// Keywords a shader variant is compiled with, each injected into both stages
+// as "#define NAME VALUE" right after the #version line. Kept sorted, so the
+// same set always gives the same key.
+class ShaderDefines {
+public:
+    ShaderDefines& Set(const std::string& name, int value = 1);
+
+    bool IsEmpty() const { return m_values.empty(); }
+    std::string GetKey() const;      // "NAME=VALUE;..." for caching variants
+    std::string GetPreamble() const; // the #define lines
+
+private:
+    std::map<std::string, int> m_values;
+};
+
+// FNV-1a of a uniform name; constexpr, so names can be hashed at compile time
+constexpr uint32_t UniformHash(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (; *name != '\0'; name++) {
+        hash = (hash ^ static_cast<unsigned char>(*name)) * 16777619u;
+    }
+    return hash;
+}
+
+// A resolved uniform: an index into one program's reflected uniform table.
+// T is checked against the GLSL type when the handle is resolved; int
+// handles also accept bools and samplers.
+template <typename T>
+struct Uniform {
+    int index = -1;
+    bool IsValid() const { return index >= 0; }
+};
+
+inline GLenum UniformGlType(const bool*) { return GL_BOOL; }
+inline GLenum UniformGlType(const int*) { return GL_INT; }
+inline GLenum UniformGlType(const float*) { return GL_FLOAT; }
+inline GLenum UniformGlType(const glm::vec2*) { return GL_FLOAT_VEC2; }
+inline GLenum UniformGlType(const glm::vec3*) { return GL_FLOAT_VEC3; }
+inline GLenum UniformGlType(const glm::vec4*) { return GL_FLOAT_VEC4; }
+inline GLenum UniformGlType(const glm::mat2*) { return GL_FLOAT_MAT2; }
+inline GLenum UniformGlType(const glm::mat3*) { return GL_FLOAT_MAT3; }
+inline GLenum UniformGlType(const glm::mat4*) { return GL_FLOAT_MAT4; }
+
 struct ShaderProgramSource {
     std::string vertexShaderSource;
     std::string fragmentShaderSource;
 };
 
+// A program built from one .glsl file. The constructor only submits the
+// compiles and the link; nothing asks the driver for a result until the
+// program is needed, so programs created back to back build concurrently
+// (on the driver's threads with GL_KHR_parallel_shader_compile). IsReady
+// polls without blocking; Use, IsValid and GetID wait for the build.
 class Shader {
 public:
-    Shader(const std::string& filepath);
+    Shader(const std::string& filepath, const ShaderDefines& defines = ShaderDefines());
     ~Shader();
 
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
     void Use() const;
-    bool IsValid() const { return m_program != 0; }
-    unsigned int GetID() const { return m_program; }
-
-    // Utility uniform functions
-    void SetBool(const std::string& name, bool value) const;
-    void SetInt(const std::string& name, int value) const;
-    void SetFloat(const std::string& name, float value) const;
-    void SetVec2(const std::string& name, const glm::vec2& value) const;
-    void SetVec2(const std::string& name, float x, float y) const;
-    void SetVec3(const std::string& name, const glm::vec3& value) const;
-    void SetVec3(const std::string& name, float x, float y, float z) const;
-    void SetVec4(const std::string& name, const glm::vec4& value) const;
-    void SetVec4(const std::string& name, float x, float y, float z, float w) const;
-    void SetMatrix2(const std::string& name, const glm::mat2& mat) const;
-    void SetMatrix3(const std::string& name, const glm::mat3& mat) const;
-    void SetMatrix4(const std::string& name, const glm::mat4& mat) const;
+    // True once the build has finished, successfully or not. Without parallel
+    // compile support this finishes the build itself, which may block.
+    bool IsReady() const;
+    bool IsValid() const { Wait(); return m_program != 0; }
+    unsigned int GetID() const { Wait(); return m_program; }
+
+    // Time from construction until the program was ready, and whether it came from the binary cache
+    double GetLoadMs() const { return m_loadMs; }
+    bool IsFromBinaryCache() const { return m_fromBinaryCache; }
+
+    // Resolve a uniform once, by name or by UniformHash of it, and set it
+    // through the handle. Names the program does not have as an active
+    // uniform of that type are reported once and give an invalid handle,
+    // which Set ignores. Set keeps the last value it sent and skips the GL
+    // call when the new one is bit-identical.
+    template <typename T>
+    Uniform<T> GetUniform(const char* name) const {
+        return { Resolve(UniformHash(name), name, UniformGlType(static_cast<const T*>(nullptr))) };
+    }
+    template <typename T>
+    Uniform<T> GetUniform(uint32_t hash) const {
+        return { Resolve(hash, nullptr, UniformGlType(static_cast<const T*>(nullptr))) };
+    }
+
+    void Set(Uniform<bool> uniform, bool value) const;
+    void Set(Uniform<int> uniform, int value) const;
+    void Set(Uniform<float> uniform, float value) const;
+    void Set(Uniform<glm::vec2> uniform, const glm::vec2& value) const;
+    void Set(Uniform<glm::vec3> uniform, const glm::vec3& value) const;
+    void Set(Uniform<glm::vec4> uniform, const glm::vec4& value) const;
+    void Set(Uniform<glm::mat2> uniform, const glm::mat2& value) const;
+    void Set(Uniform<glm::mat3> uniform, const glm::mat3& value) const;
+    void Set(Uniform<glm::mat4> uniform, const glm::mat4& value) const;
+
+    // Utility uniform functions; resolve by name on every call, so keep them off hot paths
+    void SetBool(const char* name, bool value) const;
+    void SetInt(const char* name, int value) const;
+    void SetFloat(const char* name, float value) const;
+    void SetVec2(const char* name, const glm::vec2& value) const;
+    void SetVec2(const char* name, float x, float y) const;
+    void SetVec3(const char* name, const glm::vec3& value) const;
+    void SetVec3(const char* name, float x, float y, float z) const;
+    void SetVec4(const char* name, const glm::vec4& value) const;
+    void SetVec4(const char* name, float x, float y, float z, float w) const;
+    void SetMatrix2(const char* name, const glm::mat2& mat) const;
+    void SetMatrix3(const char* name, const glm::mat3& mat) const;
+    void SetMatrix4(const char* name, const glm::mat4& mat) const;
+
+    int GetUniformCount() const { Wait(); return static_cast<int>(m_uniforms.size()); }
+
+    // Uniform writes sent to GL and skipped as unchanged, across all programs
+    static void ResetUniformCounters() { s_issuedUniforms = 0; s_skippedUniforms = 0; }
+    static int GetIssuedUniformCount() { return s_issuedUniforms; }
+    static int GetSkippedUniformCount() { return s_skippedUniforms; }
 
 private:
-    unsigned int m_program;
+    // One active uniform outside any block; arrays add their bare name and every element
+    struct UniformEntry {
+        uint32_t hash;
+        GLint location;
+        GLenum type;
+        uint32_t slot; // shadow of the value; an array's bare name shares element 0's
+    };
+
+    // Last value sent for one location, compared bitwise
+    struct UniformShadow {
+        float value[16];
+        bool valid = false;
+    };
+
+    std::string m_filepath;
+
+    // Finishing a build is a side effect of asking about the program, hence mutable
+    mutable unsigned int m_program;
+    mutable unsigned int m_vertexShader, m_fragmentShader; // held while the build is in flight
+    mutable bool m_building;
+    mutable double m_loadMs;
+    bool m_fromBinaryCache;
+    uint64_t m_cacheKey;
+    std::chrono::steady_clock::time_point m_buildStart;
+    mutable std::vector<UniformEntry> m_uniforms; // sorted by hash
+    mutable std::vector<UniformShadow> m_shadows;
+    mutable std::vector<uint32_t> m_reported;     // unknown names already reported
 
     // Utility functions
     ShaderProgramSource ParseShader(const std::string& filepath);
+    static void InjectDefines(std::string& source, const std::string& preamble);
     unsigned int CompileShader(unsigned int type, const std::string& source);
-    unsigned int CreateShaderProgram(const std::string& vertexShader, const std::string& fragmentShader);
+    static bool CheckCompile(unsigned int shader, unsigned int type);
+    void StartBuild(const std::string& vertexShader, const std::string& fragmentShader);
+    void Wait() const { if (m_building) FinishBuild(); }
+    void FinishBuild() const;
+    void ReflectUniforms() const;
+    void BindUniformBlocks() const;
+    int Resolve(uint32_t hash, const char* name, GLenum type) const;
+    template <typename T>
+    bool Changed(int index, const T& value) const;
+
+    static int s_issuedUniforms;
+    static int s_skippedUniforms;
 };
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "ShaderVariants.h"
+#include <iostream>
+
+ShaderVariants::ShaderVariants(const std::string& filepath, Setup setup)
+    : m_filepath(filepath), m_setup(std::move(setup))
+{
+}
+
+ShaderVariants::Variant& ShaderVariants::Find(const ShaderDefines& defines) {
+    std::string key = defines.GetKey();
+    auto it = m_variants.find(key);
+    if (it == m_variants.end()) {
+        Variant variant;
+        variant.key = key;
+        variant.shader.reset(new Shader(m_filepath, defines));
+        it = m_variants.emplace(key, std::move(variant)).first;
+    }
+    return it->second;
+}
+
+void ShaderVariants::Complete(Variant& variant) {
+    if (variant.complete) return;
+    variant.complete = true;
+
+    // Failed variants stay cached too, so a broken permutation reports once
+    if (!variant.shader->IsValid()) {
+        std::cerr << "ShaderVariants: " << m_filepath << " failed with defines [" << variant.key << "]" << std::endl;
+    }
+    else if (m_setup) {
+        m_setup(*variant.shader);
+    }
+}
+
+void ShaderVariants::Request(const ShaderDefines& defines) {
+    Find(defines);
+}
+
+const Shader& ShaderVariants::Get(const ShaderDefines& defines) {
+    Variant& variant = Find(defines);
+    Complete(variant);
+    return *variant.shader;
+}
+
+const Shader* ShaderVariants::TryGet(const ShaderDefines& defines) {
+    Variant& variant = Find(defines);
+    if (!variant.shader->IsReady()) return nullptr;
+    Complete(variant);
+    return variant.shader->IsValid() ? variant.shader.get() : nullptr;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Shader.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Every permutation of one shader file that has been asked for, keyed by its
+// defines. A variant starts building the first time its key is seen and is
+// handed to the setup callback once it is ready, for the uniforms that never
+// change (sampler units, constants); after that lookups are a hash find.
+// Callers pick the variant that matches exactly what a material uses, so the
+// shader needs no uniform branches for features that are off.
+class ShaderVariants {
+public:
+    using Setup = std::function<void(const Shader&)>;
+
+    explicit ShaderVariants(const std::string& filepath, Setup setup = Setup());
+
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+    // Start building a variant without waiting for it
+    void Request(const ShaderDefines& defines);
+
+    // The variant, waiting for its build if needed
+    const Shader& Get(const ShaderDefines& defines);
+
+    // The variant if it is built and valid, otherwise nullptr (and the build
+    // is started). Never waits with parallel compile support; without it,
+    // finishing the build is the only way to learn its result, so this may
+    // block like Get (see Shader::IsReady).
+    const Shader* TryGet(const ShaderDefines& defines);
+
+    int GetVariantCount() const { return static_cast<int>(m_variants.size()); }
+
+private:
+    struct Variant {
+        std::string key;
+        std::unique_ptr<Shader> shader;
+        bool complete = false; // checked and set up
+    };
+
+    std::string m_filepath;
+    Setup m_setup;
+    std::unordered_map<std::string, Variant> m_variants;
+
+    Variant& Find(const ShaderDefines& defines);
+    void Complete(Variant& variant);
+};
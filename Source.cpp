@@ -1,17 +1,54 @@
 #include "Renderer.h"
 #include "Camera.h"
 #include "Shader.h"
+#include "ShaderVariants.h"
+#include "ProgramBinaryCache.h"
 #include "Texture.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
 #include "Lighting.h"
+#include "LightClusters.h"
+#include "DeferredShading.h"
 #include "Model.h"
+#include "InstanceBuffer.h"
+#include "World.h"
+#include "WorldStreamer.h"
+#include "DrawSubmitter.h"
+#include "NormalMatrices.h"
+#include "RenderQueue.h"
+#include "SceneOctree.h"
+#include "OcclusionCuller.h"
+#include "GpuTimer.h"
+#include "RingBuffer.h"
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <cstring>
+#include <memory>
 #include <vector>
 #include <algorithm>
+#include <cmath>
+#include <random>
 
 
 
+enum class CubeRenderMode {
+    Chunked = 0,   // one greedy-meshed draw per chunk
+    Instanced = 1, // one instanced draw for the whole grid
+    PerCube = 2    // one draw per cube
+};
+
+// Kinds of object in the scene octree; user data is kind << 24 | index
+enum class SceneObject : uint32_t {
+    House = 0,
+    Bulb = 1,
+    Cube = 2
+};
+
+uint32_t sceneObjectId(SceneObject kind, uint32_t index) {
+    return ((uint32_t)kind << 24) | index;
+}
+
 int getSelectedCube(const glm::vec3 *cubePositions, int numCubes, int screenWidth, int screenHeight, const glm::mat4 &view, const glm::mat4 &projection, const Camera &camera) {
     
     std::vector<std::pair<float, int>> candidate;
@@ -38,10 +75,82 @@ int getSelectedCube(const glm::vec3 *cubePositions, int numCubes, int screenWidt
 
 }
 
-int main() {
+// Scatter count small point lights over the ground after the bulb lights;
+// seeded, so the same count always gives the same lights
+void setExtraLights(Lighting& lighting, int bulbCount, int count) {
+    lighting.SetPointLightCount(bulbCount);
+    std::mt19937 rng(1337);
+    std::uniform_real_distribution<float> spread(-64.0f, 64.0f);
+    std::uniform_real_distribution<float> height(1.0f, 3.0f);
+    std::uniform_real_distribution<float> radius(2.0f, 6.0f);
+    std::uniform_real_distribution<float> channel(0.2f, 1.0f);
+    for (int i = 0; i < count; i++) {
+        glm::vec3 position(spread(rng), height(rng), spread(rng));
+        glm::vec3 color(channel(rng), channel(rng), channel(rng));
+        lighting.AddPointLight(position, color, radius(rng));
+    }
+}
+
+// Keywords of the forward cube program for the lights that are switched on;
+// point lights always reach it through the clusters
+ShaderDefines forwardLightDefines(bool dirLight, bool spotLight) {
+    ShaderDefines defines;
+    defines.Set("USE_POINT_LIGHTS");
+    if (dirLight) defines.Set("USE_DIRLIGHT");
+    if (spotLight) defines.Set("USE_SPOTLIGHT");
+    return defines;
+}
+
+// Flat ground grid of cubes centred on the given block
+void generateCubePositions(std::vector<glm::vec3>& cubePositions, int centerX, int centerZ, int renderDistance, float spacing) {
+    cubePositions.clear();
+    for (int x = -renderDistance; x <= renderDistance; x++) {
+        for (int z = -renderDistance; z <= renderDistance; z++) {
+            cubePositions.push_back(glm::vec3(
+                centerX + x * spacing,
+                0.0f, // flat ground
+                centerZ + z * spacing
+            ));
+        }
+    }
+}
+
+// Re-centre the grid on a new block by wrapping the cubes that fell off the
+// trailing edge round to the leading one, so crossing a block moves one row
+// of cubes instead of rebuilding the grid. Appends the indices it moved.
+void shiftCubePositions(std::vector<glm::vec3>& cubePositions, int centerX, int centerZ, int renderDistance, float spacing,
+                        std::vector<uint32_t>& moved) {
+    const float width = (2 * renderDistance + 1) * spacing;
+    const float reach = (renderDistance + 0.5f) * spacing;
+    for (uint32_t i = 0; i < cubePositions.size(); i++) {
+        glm::vec3& position = cubePositions[i];
+        const glm::vec3 before = position;
+        while (position.x < centerX - reach) position.x += width;
+        while (position.x > centerX + reach) position.x -= width;
+        while (position.z < centerZ - reach) position.z += width;
+        while (position.z > centerZ + reach) position.z -= width;
+        if (position != before) {
+            moved.push_back(i);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    // --deferred picks the deferred path; forward with clustered lights is the default.
+    // --no-program-cache compiles every shader from source, for a cold start.
+    bool deferredShading = false;
+    bool programCache = true;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--deferred") == 0) deferredShading = true;
+        if (std::strcmp(argv[i], "--no-program-cache") == 0) programCache = false;
+    }
+
     if (!Renderer::Initialize()) {
         return -1;
     }
+    if (programCache) {
+        ProgramBinaryCache::Initialize("shader_cache");
+    }
 
     GLFWwindow* window = Renderer::GetWindow();
     Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -53,24 +162,104 @@ int main() {
         cam->ProcessMouseMovement(xpos, ypos);
     });
 
-    // Load shaders
-    Shader CubeShader("resources/Shaders/Basic_shader.glsl");
+    // Load textures; they show a grey placeholder until decoded and uploaded.
+    // The cubes and the house's materials share them through the cache.
+    TextureLoader textureLoader;
+    TextureCache textureCache(&textureLoader);
+    // BC1 copies of the crate maps, an eighth of the PNGs' size in memory; a
+    // context without S3TC falls back to the PNGs
+    const std::string crateExtension = Renderer::GetCaps().textureS3TC ? ".dds" : ".png";
+    std::shared_ptr<Texture> diffuseMap = textureCache.Get("resources/Textures/container2" + crateExtension);
+    std::shared_ptr<Texture> specularMap = textureCache.Get("resources/Textures/container2_specular" + crateExtension);
+
+    // Loaded before the shaders: its material decides the house variant
+    Model house("resources/Model/House.obj", "resources/Model/", ModelLodSettings(), &textureCache);
+    ShaderDefines houseDefines;
+    if (house.diffuseTexture) {
+        houseDefines.Set("HAS_TEXTURE");
+    }
+    if (house.specularTexture) {
+        houseDefines.Set("HAS_SPECULAR_MAP");
+    }
+
+    // Load shaders. Constructing one only submits its build, so everything
+    // below compiles concurrently until the validity checks wait for it. The
+    // forward cube program has a variant per set of lights.
+    auto shaderStart = std::chrono::steady_clock::now();
+    const float materialShininess = 32.0f;
+    ShaderVariants cubeVariants("resources/Shaders/Basic_shader.glsl", [&](const Shader& shader) {
+        shader.Use();
+        shader.SetInt("u_drawData", DrawSubmitter::DRAW_DATA_TEXTURE_UNIT);
+        shader.SetBool("u_useDrawData", true);
+        // The per-cube path only translates, so its normal matrix is the identity
+        shader.SetMatrix3("u_normalMatrix", glm::mat3(1.0f));
+
+        // Material constants; lights come from the light block
+        shader.SetInt("material.diffuse", 0);
+        shader.SetInt("material.specular", 1);
+        shader.SetFloat("material.shininess", materialShininess);
+        shader.SetInt("u_pointLights", Lighting::POINT_LIGHT_TEXTURE_UNIT);
+        shader.SetInt("u_clusterLights", LightClusters::CLUSTER_LIGHTS_TEXTURE_UNIT);
+        shader.SetInt("u_clusterTable", LightClusters::CLUSTER_TABLE_TEXTURE_UNIT);
+    });
+    bool dirLightOn = false;
+    bool spotLightOn = true;
+
     Shader lightCubeShader("resources/Shaders/bulb_shader.glsl");
 	Shader OutlineShader("resources/Shaders/outline.glsl");
-    Shader ModelShader("resources/Shaders/house_shader.glsl");
+    Shader ModelShader("resources/Shaders/house_shader.glsl", houseDefines);
+    Shader GBufferShader("resources/Shaders/gbuffer_shader.glsl");
+    Shader DepthPrepassShader("resources/Shaders/depth_prepass.glsl");
 
-    if (!CubeShader.IsValid() || !lightCubeShader.IsValid()) {
+    // Every light permutation builds alongside the rest, so the toggles rarely wait
+    for (int lights = 0; lights < 4; lights++) {
+        cubeVariants.Request(forwardLightDefines((lights & 1) != 0, (lights & 2) != 0));
+    }
+    // Last ready forward variant; stands in while a newly toggled one builds
+    const Shader* forwardCubeShader = &cubeVariants.Get(forwardLightDefines(dirLightOn, spotLightOn));
+
+    if (!forwardCubeShader->IsValid() || !lightCubeShader.IsValid() || !GBufferShader.IsValid() || !DepthPrepassShader.IsValid()) {
         std::cerr << "Failed to load shaders!" << std::endl;
         return -1;
     }
 
-    // Load textures
-    Texture diffuseMap("resources/Textures/container2.png");
-    Texture specularMap("resources/Textures/container2_specular.png");
+    // Cold start compiles everything, a warm one loads every binary from the
+    // cache. Builds overlap, so the total is wall time, not the sum.
+    const double shaderStartupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count();
+    const struct { const char* name; const Shader* shader; } startupShaders[] = {
+        { "Basic", forwardCubeShader },
+        { "bulb", &lightCubeShader },
+        { "outline", &OutlineShader },
+        { "house", &ModelShader },
+        { "gbuffer", &GBufferShader },
+        { "depth_prepass", &DepthPrepassShader }
+    };
+    int cachedShaders = 0;
+    for (const auto& entry : startupShaders) {
+        std::cout << "  " << entry.name << ": ready after " << entry.shader->GetLoadMs() << " ms"
+                  << (entry.shader->IsFromBinaryCache() ? " (binary cache)" : " (compiled)") << std::endl;
+        cachedShaders += entry.shader->IsFromBinaryCache() ? 1 : 0;
+    }
+    const bool warmStart = cachedShaders == (int)(sizeof(startupShaders) / sizeof(startupShaders[0]));
+    std::cout << "Shader startup: " << shaderStartupMs << " ms, " << (warmStart ? "warm" : "cold")
+              << " (" << cachedShaders << " from the binary cache)" << std::endl;
+
+    // The cube field is what the two paths are compared on
+    std::unique_ptr<DeferredShading> deferred;
+    if (deferredShading) {
+        deferred.reset(new DeferredShading());
+        if (!deferred->IsValid()) {
+            std::cerr << "Failed to load deferred lighting shaders!" << std::endl;
+            return -1;
+        }
+    }
+    std::cout << "Renderer path: " << (deferredShading ? "deferred" : "forward") << std::endl;
 
-    // Initialize lighting system
+    // Initialize lighting system; point lights reach the cube shader through clusters
     Lighting lighting;
-    MultipleLightUniforms uniforms = lighting.InitializeUniforms(CubeShader.GetID());
+    LightClusters lightClusters;
+    const int bulbCount = lighting.GetPointLightCount();
+    int extraLights = 0;
 
     // Set up cube data
     float vertices[] = {
@@ -140,15 +329,23 @@ int main() {
 
     std::cout << "Player Block Position: (" << playerBlockX << ", " << playerBlockZ << ")\n";
 
-    for (int x = -renderDistance; x <= renderDistance; x++) {
-        for (int z = -renderDistance; z <= renderDistance; z++) {
-            cubePositions.push_back(glm::vec3(
-                playerBlockX + x * spacing,
-                0.0f, // flat ground
-                playerBlockZ + z * spacing
-            ));
-        }
-    }
+    generateCubePositions(cubePositions, playerBlockX, playerBlockZ, renderDistance, spacing);
+
+    // Chunked ground streams in around the camera; the benchmark grid follows the player's block
+    World world;
+    WorldStreamer streamer(world);
+    int streamRadius = streamer.GetLoadRadius();
+    int cubeRenderMode = (int)CubeRenderMode::Chunked;
+
+    // Instanced path: one transform per visible cube, streamed every frame
+    bool cubePositionsDirty = true;
+    std::vector<uint32_t> movedCubes; // shifted since the index last saw them
+    std::vector<glm::mat4> cubeTransforms;
+
+    // Culling results for the benchmark cubes and the light bulbs
+    std::vector<uint32_t> visibleCubes;
+    std::vector<uint32_t> visibleBulbs;
+    CullBenchmarkResult cullBenchmark;
 
 
     // Set up vertex arrays and buffers
@@ -157,7 +354,7 @@ int main() {
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
+    Renderer::BindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
@@ -174,20 +371,117 @@ int main() {
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
 
-    // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_STENCIL_TEST);
+    // Per-instance model matrix (locations 3-6) and normal matrix (8-10)
+    InstanceBuffer cubeInstances;
+    cubeInstances.AttachToVertexArray(VAO, 3, 8);
+
+    // Light bulbs reuse the cube geometry but only need positions and a draw ID
+    unsigned int bulbVAO;
+    glGenVertexArrays(1, &bulbVAO);
+    Renderer::BindVertexArray(bulbVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    Renderer::BindVertexArray(0);
+
+    // The scene draws with stencil writes off; clearing needs every mask open
+    PipelineStateDesc sceneDesc;
+    sceneDesc.stencilTest = true;
+    sceneDesc.stencilWriteMask = 0x00;
+    PipelineState scenePipeline(sceneDesc);
+
+    // Depth pre-pass: depth only, then colour where depth matches exactly
+    PipelineStateDesc prepassDesc = sceneDesc;
+    prepassDesc.colorWrite = false;
+    PipelineState prepassPipeline(prepassDesc);
+
+    PipelineStateDesc equalDesc = sceneDesc;
+    equalDesc.depthFunc = GL_EQUAL;
+    equalDesc.depthWrite = false;
+    PipelineState equalDepthPipeline(equalDesc);
+
+    PipelineStateDesc clearDesc;
+    clearDesc.stencilTest = true;
+    PipelineState clearPipeline(clearDesc);
+    Renderer::ApplyPipelineState(clearPipeline);
 
     // Setup ImGui
     Renderer::InitializeImGui();
 
     // Performance monitoring
-    GLuint timerQuery;
-    glGenQueries(1, &timerQuery);
-    GLuint64 elapsed_time;
+    GpuTimer frameTimer;
+    GLuint64 elapsed_time = 0;
+
+    // Averaged GPU frame time with occlusion culling off [0] and on [1]
+    double gpuFrameAverage[2] = { 0.0, 0.0 };
+    bool occlusionCulling = false;
+
+    // Fragment shader invocations of the scene, averaged with the depth
+    // pre-pass off [0] and on [1]; needs pipeline statistics queries
+    bool depthPrepass = false;
+    const bool countFragments = Renderer::GetCaps().pipelineStatistics;
+    GpuTimer fragmentCounter(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+    double fragmentAverage[2] = { 0.0, 0.0 };
+
+    // Screen-space error allowed when picking the house's level of detail
+    float lodPixelError = 1.0f;
+    int houseLod = 0;
     float lastFrame = 0.0f;
     
-    Model house("resources/Model/House.obj", "resources/Model/");
+    glm::mat4 houseModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.6f, 1.0f));
+
+    // Scene index over the house, the bulbs and (in the benchmark modes) the
+    // cubes; chunks live in the world's own index
+    SceneOctree scene(glm::vec3(0.0f), 256.0f);
+    std::vector<SceneHandle> visibleScene;
+
+    glm::vec3 houseCenter = house.GetBoundsCenter();
+    glm::vec3 houseExtent = house.GetBoundsExtent();
+    Frustum::TransformBox(houseModel, houseCenter, houseExtent);
+    scene.Insert(houseCenter, houseExtent, sceneObjectId(SceneObject::House, 0));
+
+    // Bulbs are 0.2-scaled unit cubes around 0.2 * light position
+    const glm::vec3 bulbExtent = glm::vec3(0.1f);
+    std::vector<SceneHandle> bulbHandles(bulbCount);
+    for (int i = 0; i < bulbCount; i++) {
+        bulbHandles[i] = scene.Insert(lighting.GetPointLightPosition(i) * 0.2f, bulbExtent, sceneObjectId(SceneObject::Bulb, i));
+    }
+
+    std::vector<SceneHandle> cubeHandles;
+    bool cubesIndexed = false;
+
+    // Batched submission for chunks, the house and the light bulbs
+    DrawSubmitter submitter;
+    RenderQueue renderQueue;
+    OcclusionCuller occlusion;
+    submitter.AttachToVertexArray(world.GetVAO());
+    submitter.AttachToVertexArray(house.GetVAO());
+    submitter.AttachToVertexArray(bulbVAO);
+
+    Shader* drawDataShaders[] = { &GBufferShader, &DepthPrepassShader, &ModelShader, &lightCubeShader };
+    for (Shader* shader : drawDataShaders) {
+        shader->Use();
+        shader->SetInt("u_drawData", DrawSubmitter::DRAW_DATA_TEXTURE_UNIT);
+    }
+
+    DepthPrepassShader.Use();
+    DepthPrepassShader.SetBool("u_useDrawData", true);
+
+    GBufferShader.Use();
+    GBufferShader.SetBool("u_useDrawData", true);
+    GBufferShader.SetMatrix3("u_normalMatrix", glm::mat3(1.0f));
+    GBufferShader.SetInt("material.diffuse", 0);
+    GBufferShader.SetInt("material.specular", 1);
+
+    ModelShader.Use();
+    ModelShader.SetVec3("lightColor", glm::vec3(1.0f));
+    if (house.diffuseTexture) {
+        ModelShader.SetInt("texture_diffuse1", 0);
+    }
+    if (house.specularTexture) {
+        ModelShader.SetInt("texture_specular1", 1);
+    }
 
     // Main render loop
     // Main render loop
@@ -199,16 +493,91 @@ int main() {
         // Process input
         camera.ProcessKeyboard(window, deltaTime);
 
+        playerPos = camera.GetPosition();
+        int blockX = static_cast<int>(std::floor(playerPos.x));
+        int blockZ = static_cast<int>(std::floor(playerPos.z));
+        if (blockX != playerBlockX || blockZ != playerBlockZ) {
+            playerBlockX = blockX;
+            playerBlockZ = blockZ;
+            shiftCubePositions(cubePositions, playerBlockX, playerBlockZ, renderDistance, spacing, movedCubes);
+        }
+        streamer.Update(playerPos);
+        textureLoader.Update();
+
+        Renderer::BeginFrame();
+
         // Start GPU timer
-        glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+        int timerTag = occlusionCulling ? 1 : 0;
+        frameTimer.Begin(timerTag);
+        submitter.ResetStats();
+        Renderer::ResetStateCounters();
+        Shader::ResetUniformCounters();
 
         // Clear
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        const glm::vec4 clearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
+        // The deferred path draws the scene into its G-buffer instead
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        if (deferred) {
+            deferred->BeginGeometryPass(framebufferWidth, framebufferHeight, clearColor);
+        }
+        if (countFragments) {
+            fragmentCounter.Begin(depthPrepass ? 1 : 0);
+        }
+
         // Get view and projection matrices
         glm::mat4 view = camera.GetViewMatrix();
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+        const float fovY = glm::radians(45.0f);
+        const float nearPlane = 0.1f, farPlane = 100.0f;
+        glm::mat4 projection = glm::perspective(fovY, 800.0f / 600.0f, nearPlane, farPlane);
+        float projectionScale = 600.0f / (2.0f * std::tan(fovY * 0.5f));
+        Frustum frustum(projection * view);
+
+        // Cubes are in the index only while a benchmark path draws them
+        bool wantCubes = cubeRenderMode != (int)CubeRenderMode::Chunked;
+        if (cubePositionsDirty || cubesIndexed != wantCubes) {
+            for (SceneHandle handle : cubeHandles) {
+                scene.Remove(handle);
+            }
+            cubeHandles.clear();
+            if (wantCubes) {
+                for (size_t i = 0; i < cubePositions.size(); i++) {
+                    cubeHandles.push_back(scene.Insert(cubePositions[i], glm::vec3(0.5f), sceneObjectId(SceneObject::Cube, (uint32_t)i)));
+                }
+            }
+            cubesIndexed = wantCubes;
+            cubePositionsDirty = false;
+        }
+        else if (cubesIndexed) {
+            for (uint32_t i : movedCubes) {
+                scene.Move(cubeHandles[i], cubePositions[i], glm::vec3(0.5f));
+            }
+        }
+        movedCubes.clear();
+
+        // Bulbs follow their lights
+        for (int i = 0; i < bulbCount; i++) {
+            scene.Move(bulbHandles[i], lighting.GetPointLightPosition(i) * 0.2f, bulbExtent);
+        }
+
+        scene.Query(frustum, visibleScene);
+        int culledObjects = scene.GetObjectCount() - (int)visibleScene.size();
+
+        bool houseVisible = false;
+        visibleCubes.clear();
+        visibleBulbs.clear();
+        for (SceneHandle handle : visibleScene) {
+            uint32_t id = scene.GetUserData(handle);
+            uint32_t index = id & 0xFFFFFF;
+            switch ((SceneObject)(id >> 24)) {
+            case SceneObject::House: houseVisible = true; break;
+            case SceneObject::Bulb: visibleBulbs.push_back(index); break;
+            case SceneObject::Cube: visibleCubes.push_back(index); break;
+            }
+        }
 
 
 
@@ -223,15 +592,9 @@ int main() {
         //    CubeShader.Use();
         //    glBindVertexArray(VAO);
 
-        //    // Set matrices
-        //    CubeShader.SetMatrix4("u_view", view);
-        //    CubeShader.SetMatrix4("u_proj", projection);
-
-        //    lighting.SetLightUniforms(uniforms, camera.GetPosition(), camera.GetFront());
-
         //    // Bind textures
-        //    diffuseMap.Bind(0);
-        //    specularMap.Bind(1);
+        //    diffuseMap->Bind(0);
+        //    specularMap->Bind(1);
 
         //    glm::mat4 model = glm::mat4(1.0f);
         //    model = glm::translate(model, cubePositions[selectedCube]);
@@ -242,49 +605,145 @@ int main() {
         //}
 
         // **Second Pass: Render Outlines**
-        glStencilFunc(GL_ALWAYS, 0, 0xFF); // Pass test if stencil value is not 1
-        glStencilMask(0x00); // Disable writing to the stencil buffer
-        glEnable(GL_DEPTH_TEST); // Disable depth testing for outline
+        Renderer::ApplyPipelineState(scenePipeline);
 
+        // Camera matrices reach every program through the camera block
+        Renderer::SetCamera(view, projection, camera.GetPosition());
 
-        CubeShader.Use();
-        glBindVertexArray(VAO);
-        CubeShader.SetMatrix4("u_view", view);
-        CubeShader.SetMatrix4("u_proj", projection);
+        // Only lights that changed are uploaded; the flashlight follows the camera
+        lighting.SetSpotlight(camera.GetPosition(), camera.GetFront());
+        lighting.Upload();
 
-        // Set lighting uniforms
-        lighting.SetLightUniforms(uniforms, camera.GetPosition(), camera.GetFront());
+        if (!deferred) {
+            lightClusters.Update(lighting, view, projection, nearPlane, farPlane, framebufferWidth, framebufferHeight);
+        }
 
-        diffuseMap.Bind(0);
-        specularMap.Bind(1);
+        if (const Shader* ready = cubeVariants.TryGet(forwardLightDefines(dirLightOn, spotLightOn))) {
+            forwardCubeShader = ready;
+        }
+        const Shader& cubeShader = deferred ? GBufferShader : *forwardCubeShader;
+
+        // The instanced and per-cube benchmark paths draw directly, outside the queue
+        bool drawBenchmarkCubes = cubeRenderMode != (int)CubeRenderMode::Chunked;
+        if (cubeRenderMode == (int)CubeRenderMode::Instanced) {
+            cubeTransforms.clear();
+            for (uint32_t index : visibleCubes) {
+                cubeTransforms.push_back(glm::translate(glm::mat4(1.0f), cubePositions[index]));
+            }
+            cubeInstances.SetTransforms(cubeTransforms);
+        }
+        auto drawCubes = [&](const Shader& shader) {
+            // Resolved once per pass; the per-cube loop only indexes the table
+            Uniform<bool> useDrawData = shader.GetUniform<bool>("u_useDrawData");
+            Uniform<bool> instanced = shader.GetUniform<bool>("u_instanced");
+            Uniform<glm::mat4> modelUniform = shader.GetUniform<glm::mat4>("u_model");
+
+            shader.Use();
+            Renderer::BindVertexArray(VAO);
+            shader.Set(useDrawData, false);
+
+            if (cubeRenderMode == (int)CubeRenderMode::Instanced) {
+                shader.Set(instanced, true);
+                glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, cubeInstances.GetCount());
+                shader.Set(instanced, false);
+            }
+            else {
+                for (uint32_t index : visibleCubes) {
+                    //if (i == selectedCube) continue;
+                    glm::mat4 model = glm::mat4(1.0f);
+                    model = glm::translate(model, cubePositions[index]);
+                    shader.Set(modelUniform, model);
+                    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+                }
+            }
+
+            shader.Set(useDrawData, true);
+        };
+
+        renderQueue.Begin(camera.GetPosition(), camera.GetFront());
+        OcclusionCuller* occluder = occlusionCulling ? &occlusion : nullptr;
+        if (occluder) {
+            occluder->BeginFrame(camera.GetPosition(), camera.GetFront());
+        }
 
-        for (auto& pos: cubePositions) {
-            //if (i == selectedCube) continue;
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, pos);
-            CubeShader.SetMatrix4("u_model", model);
-            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        if (cubeRenderMode == (int)CubeRenderMode::Chunked) {
+            world.UpdateMeshes();
+
+            RenderItem chunkItem;
+            chunkItem.shader = &cubeShader;
+            chunkItem.textures[0] = diffuseMap.get();
+            chunkItem.textures[1] = specularMap.get();
+            world.Enqueue(renderQueue, chunkItem, frustum, occluder);
+            culledObjects += world.GetCulledCount();
         }
+
         //model drawing
-		ModelShader.Use();
-        glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, 0.6f, 1.0f));
-		//model = glm::scale(model, glm::vec3(.1f, .1f, .1f));
-
-        ModelShader.SetMatrix4("u_model", model);
-        ModelShader.SetMatrix4("u_view", view);
-        ModelShader.SetMatrix4("u_proj", projection);
-        ModelShader.SetVec3("viewPos", camera.GetPosition());
-        ModelShader.SetVec3("lightPos", camera.GetPosition()); // if flashlight
-        ModelShader.SetVec3("lightColor", glm::vec3(1.0f));
-
-        // Material from .mtl
-        ModelShader.SetBool("hasTexture", false); // true if later you add textures
-        ModelShader.SetVec3("materialDiffuse", house.materialDiffuse);
-        ModelShader.SetVec3("materialSpecular", house.materialSpecular);
-        ModelShader.SetFloat("materialShininess", house.materialShininess);
-
-        house.Draw();
+        if (houseVisible) {
+            // Material from .mtl
+            RenderItem houseItem;
+            houseItem.shader = &ModelShader;
+            houseItem.vao = house.GetVAO();
+            float houseDistance = std::max(glm::length(houseCenter - camera.GetPosition()) - glm::length(houseExtent), 0.1f);
+            houseLod = house.SelectLod(houseDistance, projectionScale, lodPixelError);
+            houseItem.firstIndex = house.GetLod(houseLod).firstIndex;
+            houseItem.indexCount = house.GetLod(houseLod).indexCount;
+            houseItem.data.model = houseModel;
+            houseItem.data.color = glm::vec4(house.materialDiffuse, 1.0f);
+            houseItem.data.material = glm::vec4(house.materialSpecular, house.materialShininess);
+            houseItem.textures[0] = house.diffuseTexture.get();
+            houseItem.textures[1] = house.specularTexture.get();
+            if (occluder) {
+                occluder->Submit(renderQueue, OcclusionId(OcclusionGroup::Scene, sceneObjectId(SceneObject::House, 0)), houseItem, houseCenter, houseExtent);
+            }
+            else {
+                renderQueue.Submit(RenderPass::Opaque, houseItem, houseCenter);
+            }
+        }
+
+        // Render point lights as colored cubes; too small to be worth a query
+        for (uint32_t i : visibleBulbs) {
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::scale(model, glm::vec3(0.2f));
+            model = glm::translate(model, lighting.GetPointLightPosition(i));
+
+            RenderItem bulbItem;
+            bulbItem.shader = &lightCubeShader;
+            bulbItem.vao = bulbVAO;
+            bulbItem.indexCount = 36;
+            bulbItem.data.model = model;
+            bulbItem.data.color = glm::vec4(lighting.GetPointLightColor(i), 1.0f);
+            renderQueue.Submit(RenderPass::Opaque, bulbItem, glm::vec3(model[3]));
+        }
+
+        // Lay down depth first so the colour pass shades only visible fragments
+        if (depthPrepass) {
+            Renderer::ApplyPipelineState(prepassPipeline);
+            if (drawBenchmarkCubes) {
+                drawCubes(DepthPrepassShader);
+            }
+            renderQueue.ExecuteDepthOnly(submitter, DepthPrepassShader);
+            Renderer::ApplyPipelineState(equalDepthPipeline);
+        }
+
+        if (drawBenchmarkCubes) {
+            diffuseMap->Bind(0);
+            specularMap->Bind(1);
+            drawCubes(cubeShader);
+        }
+        renderQueue.Execute(submitter);
+
+        // Objects drawn under a query result were not in the pre-pass, so
+        // they depth test and write as usual
+        if (occluder) {
+            occluder->Execute(submitter, scenePipeline);
+        }
+        if (countFragments) {
+            fragmentCounter.End();
+        }
+
+        if (deferred) {
+            deferred->LightingPass(lighting, projection * view, materialShininess);
+        }
 
         // Render scaled cubes for outline
    //     if (selectedCube != -1){
@@ -292,8 +751,6 @@ int main() {
 			//glStencilMask(0x00);
 			//glDisable(GL_DEPTH_TEST);
 			//OutlineShader.Use();
-			//OutlineShader.SetMatrix4("u_view", view);
-			//OutlineShader.SetMatrix4("u_proj", projection);
 			//OutlineShader.SetFloat("u_time", glfwGetTime());
 			//glm::mat4 model = glm::mat4(1.0f);
    //         float scale = 1.01f; // Scale factor for the outline
@@ -305,28 +762,8 @@ int main() {
 
    //     }
 
-        // Reset stencil and depth state
-        glStencilMask(0xFF); // Re-enable stencil writing
-        glStencilFunc(GL_ALWAYS, 0, 0xFF); // Reset stencil test
-        glEnable(GL_DEPTH_TEST); // Re-enable depth testing
-
-        // **Render Light Cubes**
-        lightCubeShader.Use();
-        lightCubeShader.SetMatrix4("u_view", view);
-        lightCubeShader.SetMatrix4("u_proj", projection);
-
-        // Render point lights as colored cubes
-        const auto& lightPositions = lighting.GetPointLightPositions();
-        const auto& lightColors = lighting.GetPointLightColors();
-
-        for (int i = 0; i < 4; i++) {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::scale(model, glm::vec3(0.2f));
-            model = glm::translate(model, lightPositions[i]);
-            lightCubeShader.SetMatrix4("u_model", model);
-            lightCubeShader.SetVec3("lightColor", lightColors[i]);
-            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-        }
+        // Reset stencil state
+        Renderer::ApplyPipelineState(clearPipeline);
 
         // ==========================================
         // IMGUI
@@ -343,29 +780,147 @@ int main() {
         static float cutoffAngle = 12.5f;
         static float outerCutoffAngle = 15.0f;
         if (ImGui::SliderFloat("Spotlight Inner Cutoff", &cutoffAngle, 5.0f, 25.0f)) {
-            lighting.UpdateSpotlightCutoff(CubeShader.GetID(), cutoffAngle, outerCutoffAngle);
+            lighting.UpdateSpotlightCutoff(cutoffAngle, outerCutoffAngle);
         }
         if (ImGui::SliderFloat("Spotlight Outer Cutoff", &outerCutoffAngle, cutoffAngle + 1.0f, 30.0f)) {
-            lighting.UpdateSpotlightCutoff(CubeShader.GetID(), cutoffAngle, outerCutoffAngle);
+            lighting.UpdateSpotlightCutoff(cutoffAngle, outerCutoffAngle);
         }
+        if (ImGui::SliderInt("Extra Point Lights", &extraLights, 0, 4096)) {
+            setExtraLights(lighting, bulbCount, extraLights);
+        }
+        ImGui::Text("Light uploads: %d bytes", lighting.GetUploadedBytes());
+        ImGui::Text("Shader startup: %.1f ms (%s; binary cache %d hits, %d misses)", shaderStartupMs,
+            warmStart ? "warm" : "cold", ProgramBinaryCache::GetHitCount(), ProgramBinaryCache::GetMissCount());
+        if (deferred) {
+            ImGui::Text("Deferred: %d light volumes (G-buffer %dx%d)", deferred->GetLightVolumeCount(), framebufferWidth, framebufferHeight);
+        }
+        else {
+            ImGui::Text("Clusters: %d of %d lights visible, %d references, max %d per cluster",
+                lightClusters.GetVisibleLightCount(), lighting.GetPointLightCount(),
+                lightClusters.GetReferenceCount(), lightClusters.GetMaxClusterLights());
+            ImGui::Text("Light assignment: %.3f ms (%s kernel)", lightClusters.GetAssignMs(), LightClusters::GetKernelName());
+            ImGui::Checkbox("Directional Light", &dirLightOn);
+            ImGui::SameLine();
+            ImGui::Checkbox("Flashlight", &spotLightOn);
+            ImGui::Text("Cube shader variants: %d requested (%s)", cubeVariants.GetVariantCount(),
+                Renderer::GetCaps().parallelShaderCompile ? "parallel compile" : "compiled on first use");
+        }
+
+        // Cube grid benchmarking
+        ImGui::Separator();
+        const char* cubeRenderModes[] = { "Chunked", "Instanced", "Per Cube" };
+        ImGui::Combo("Cube Rendering", &cubeRenderMode, cubeRenderModes, 3);
+        if (cubeRenderMode == (int)CubeRenderMode::Chunked) {
+            if (ImGui::SliderInt("Stream Radius", &streamRadius, 2, 16)) {
+                streamer.SetLoadRadius(streamRadius);
+            }
+            ImGui::Text("Chunks: %d (%d draw calls, %d triangles)", world.GetChunkCount(), world.GetDrawCount(), world.GetTriangleCount());
+            ImGui::Text("Streaming: %d pending, %d uploaded this frame, %d workers",
+                streamer.GetPendingCount(), streamer.GetUploadedCount(), streamer.GetWorkerCount());
+        }
+        else {
+            if (ImGui::SliderInt("Render Distance", &renderDistance, 1, 64)) {
+                generateCubePositions(cubePositions, playerBlockX, playerBlockZ, renderDistance, spacing);
+                cubePositionsDirty = true;
+            }
+            int drawCalls = cubeRenderMode == (int)CubeRenderMode::Instanced ? 1 : (int)visibleCubes.size();
+            ImGui::Text("Cubes: %d of %d visible (%d draw calls, %d triangles)",
+                (int)visibleCubes.size(), (int)cubePositions.size(), drawCalls, (int)visibleCubes.size() * 12);
+        }
+        ImGui::Text("Frustum culled: %d objects (%s kernel)", culledObjects, Frustum::GetKernelName());
+        ImGui::Text("Scene octree: %d nodes, %d visited, %d objects tested",
+            scene.GetNodeCount(), scene.GetNodesVisited(), scene.GetObjectsTested());
+        const SceneOctree& chunkIndex = world.GetSceneIndex();
+        ImGui::Text("Chunk octree: %d nodes, %d visited, %d chunks tested",
+            chunkIndex.GetNodeCount(), chunkIndex.GetNodesVisited(), chunkIndex.GetObjectsTested());
+        if (ImGui::Button("Run Culling Benchmark")) {
+            cullBenchmark = RunCullBenchmark();
+            std::cout << "Culling " << cullBenchmark.boxCount << " boxes: scalar " << cullBenchmark.scalarMs
+                      << " ms, " << Frustum::GetKernelName() << " " << cullBenchmark.simdMs << " ms, "
+                      << cullBenchmark.visibleCount << " visible" << std::endl;
+        }
+        if (cullBenchmark.boxCount > 0) {
+            ImGui::Text("%d boxes: scalar %.3f ms, %s %.3f ms", cullBenchmark.boxCount,
+                cullBenchmark.scalarMs, Frustum::GetKernelName(), cullBenchmark.simdMs);
+        }
+        ImGui::Text("Submission: %s, %d draws in %d calls",
+            submitter.UsesMultiDrawIndirect() ? "multi-draw indirect" : "base-vertex fallback",
+            submitter.GetDrawCount(), submitter.GetCallCount());
+        ImGui::Text("Normal matrices: %s, %d of %d draws identity", NormalMatrices::GetKernelName(),
+            submitter.GetIdentityNormalCount(), submitter.GetDrawCount());
+        const StateSwitches& unsorted = renderQueue.GetUnsortedSwitches();
+        const StateSwitches& sorted = renderQueue.GetSortedSwitches();
+        ImGui::Text("Queue: %d items (%d waiting on shader builds)", renderQueue.GetItemCount(), renderQueue.GetSkippedCount());
+        ImGui::Text("Switches saved by sort: program %d, VAO %d, texture %d",
+            unsorted.programs - sorted.programs, unsorted.vertexArrays - sorted.vertexArrays, unsorted.textures - sorted.textures);
+        ImGui::Text("GL state calls: %d issued, %d elided by cache",
+            Renderer::GetIssuedCallCount(), Renderer::GetElidedCallCount());
+        ImGui::Text("Uniform writes: %d issued, %d skipped as unchanged",
+            Shader::GetIssuedUniformCount(), Shader::GetSkippedUniformCount());
+        ImGui::Text("Textures: %d loading, %.1f KB uploaded this frame, %d workers",
+            textureLoader.GetPendingCount() + textureLoader.GetUploadingCount(),
+            textureLoader.GetUploadedBytes() / 1024.0, textureLoader.GetWorkerCount());
+        ImGui::Text("Texture cache: %d unique, %d shared requests",
+            textureCache.GetTextureCount(), textureCache.GetHitCount());
+        const RingBuffer& frameRing = Renderer::GetFrameRing();
+        ImGui::Text("Frame ring: %s, %.1f KB streamed of %.1f MB, %d stalls",
+            frameRing.IsPersistent() ? "persistent" : "map range", frameRing.GetFrameBytes() / 1024.0,
+            frameRing.GetSize() / (1024.0 * 1024.0), frameRing.GetStallCount());
+        ImGui::SliderFloat("LOD Pixel Error", &lodPixelError, 0.25f, 16.0f);
+        ImGui::Text("House LOD: %d of %d (%d triangles)", houseLod, house.GetLodCount() - 1, (int)house.GetLod(houseLod).indexCount / 3);
+        ImGui::Checkbox("Occlusion Culling", &occlusionCulling);
+        if (occlusionCulling) {
+            ImGui::Text("Occlusion: %d of %d objects hidden, %d queries issued",
+                occlusion.GetOccludedCount(), occlusion.GetTestedCount(), occlusion.GetQueryCount());
+        }
+        if (gpuFrameAverage[0] > 0.0 && gpuFrameAverage[1] > 0.0) {
+            ImGui::Text("GPU time saved by occlusion: %.3f ms (%.3f off, %.3f on)",
+                gpuFrameAverage[0] - gpuFrameAverage[1], gpuFrameAverage[0], gpuFrameAverage[1]);
+        }
+        ImGui::Checkbox("Depth Pre-pass", &depthPrepass);
+        if (!countFragments) {
+            ImGui::Text("Fragment invocations: no pipeline statistics queries");
+        }
+        else if (fragmentAverage[0] > 0.0 && fragmentAverage[1] > 0.0) {
+            ImGui::Text("Fragment invocations saved by pre-pass: %.0f (%.0f off, %.0f on)",
+                fragmentAverage[0] - fragmentAverage[1], fragmentAverage[0], fragmentAverage[1]);
+        }
+        ImGui::Text("CPU frame: %.3f ms", deltaTime * 1000.0f);
+        ImGui::Text("GPU frame: %.3f ms", elapsed_time / 1000000.0);
 
         ImGui::End();
 
         Renderer::EndImGuiFrame();
 
-        // End GPU timer
-        glEndQuery(GL_TIME_ELAPSED);
-        glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &elapsed_time);
+        // End GPU timer and pick up whichever earlier frames have finished
+        frameTimer.End();
+        GLuint64 frameTime;
+        int frameTag;
+        while (frameTimer.PopResult(frameTime, frameTag)) {
+            elapsed_time = frameTime;
+            double ms = frameTime / 1000000.0;
+            double& average = gpuFrameAverage[frameTag];
+            average = average == 0.0 ? ms : average * 0.95 + ms * 0.05;
+        }
+        GLuint64 fragments;
+        int fragmentTag;
+        while (fragmentCounter.PopResult(fragments, fragmentTag)) {
+            double& average = fragmentAverage[fragmentTag];
+            average = average == 0.0 ? (double)fragments : average * 0.95 + fragments * 0.05;
+        }
 
+        Renderer::EndFrame();
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
     // Cleanup
     glDeleteVertexArrays(1, &VAO);
+    Renderer::OnVertexArrayDeleted(VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
-    glDeleteQueries(1, &timerQuery);
+    glDeleteVertexArrays(1, &bulbVAO);
+    Renderer::OnVertexArrayDeleted(bulbVAO);
     
     Renderer::Cleanup();
     return 0;
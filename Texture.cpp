@@ -1,13 +1,23 @@
 #include "Texture.h"
+#include "Renderer.h"
+#include "TextureContainer.h"
+#include "TextureLoader.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include <iostream>
 
-Texture::Texture(const std::string& path)
-    : m_textureID(0), m_width(0), m_height(0), m_channels(0), m_filePath(path)
+Texture::Texture(const std::string& path, const TextureParams& params)
+    : m_textureID(0), m_width(0), m_height(0), m_channels(0), m_filePath(path), m_params(params),
+      m_loader(nullptr), m_loaded(true)
 {
     glGenTextures(1, &m_textureID);
 
+    // Pre-compressed blocks with their own mips go straight to the driver
+    if (TextureContainer::IsContainer(path)) {
+        LoadContainer();
+        return;
+    }
+
     // Load image
     stbi_set_flip_vertically_on_load(true);
     unsigned char* data = stbi_load(path.c_str(), &m_width, &m_height, &m_channels, 0);
@@ -21,14 +31,14 @@ Texture::Texture(const std::string& path)
         else if (m_channels == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, m_textureID);
+        Renderer::BindTextureForUpdate(0, GL_TEXTURE_2D, m_textureID);
 
         glTexImage2D(GL_TEXTURE_2D, 0, format, m_width, m_height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
         // Set texture wrapping parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, m_params.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, m_params.wrap);
 
         // Set texture filtering parameters
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
@@ -44,17 +54,69 @@ Texture::Texture(const std::string& path)
     stbi_image_free(data);
 }
 
+void Texture::LoadContainer() {
+    CompressedImage image;
+    std::string error;
+    if (TextureContainer::Load(m_filePath, image, error) && !TextureContainer::IsSupported(image.internalFormat)) {
+        error = std::string(image.formatName) + " is not supported by this context";
+    }
+    if (!error.empty()) {
+        std::cout << "Failed to load texture: " << m_filePath << " (" << error << ")" << std::endl;
+        glDeleteTextures(1, &m_textureID);
+        m_textureID = 0;
+        return;
+    }
+
+    m_width = image.levels[0].width;
+    m_height = image.levels[0].height;
+    m_channels = image.channels;
+
+    Renderer::BindTextureForUpdate(0, GL_TEXTURE_2D, m_textureID);
+    TextureContainer::Upload(image);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, m_params.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, m_params.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    std::cout << "Texture loaded successfully: " << m_filePath << " (" << image.formatName << ", " << m_width << "x"
+              << m_height << ", " << image.levels.size() << " levels, " << image.data.size() / 1024 << " KB)" << std::endl;
+}
+
+Texture::Texture(const std::string& path, TextureLoader& loader, const TextureParams& params)
+    : m_textureID(loader.GetPlaceholder()), m_width(1), m_height(1), m_channels(4), m_filePath(path), m_params(params),
+      m_loader(&loader), m_loaded(false)
+{
+    loader.Load(*this, path);
+}
+
+void Texture::FinishLoad(unsigned int textureID, int width, int height, int channels) {
+    m_textureID = textureID;
+    m_width = width;
+    m_height = height;
+    m_channels = channels;
+    m_loader = nullptr;
+    m_loaded = true;
+}
+
+void Texture::FailLoad() {
+    // Keeps the placeholder, which stays the loader's
+    m_loader = nullptr;
+}
+
 Texture::~Texture() {
-    if (m_textureID != 0) {
+    if (m_loader) {
+        m_loader->Cancel(*this);
+    }
+    if (m_loaded && m_textureID != 0) {
         glDeleteTextures(1, &m_textureID);
+        Renderer::OnTextureDeleted(m_textureID);
     }
 }
 
 void Texture::Bind(unsigned int slot) const {
-    glActiveTexture(GL_TEXTURE0 + slot);
-    glBindTexture(GL_TEXTURE_2D, m_textureID);
+    Renderer::BindTexture(slot, GL_TEXTURE_2D, m_textureID);
 }
 
-void Texture::Unbind() const {
-    glBindTexture(GL_TEXTURE_2D, 0);
+void Texture::Unbind(unsigned int slot) const {
+    Renderer::BindTexture(slot, GL_TEXTURE_2D, 0);
 }
\ No newline at end of file
@@ -3,24 +3,53 @@
 #include <glad/glad.h>
 #include <string>
 
+class TextureLoader;
+
+// How a texture is sampled. Without sampler objects this lives in the
+// texture itself, so two uses of one file with different params need two
+// textures.
+struct TextureParams {
+    GLenum wrap = GL_REPEAT;
+};
+
+// A 2D texture from an image file. PNG, JPEG and the other formats stb_image
+// reads are decoded to RGB(A)8 and get runtime mipmaps; DDS and KTX2 files
+// keep their BCn blocks and stored mip chain (see TextureContainer).
 class Texture {
 public:
-    Texture(const std::string& path);
+    Texture(const std::string& path, const TextureParams& params = TextureParams());
+    // Decodes on the loader's workers; until then the texture binds the
+    // loader's placeholder. The loader must outlive the texture.
+    Texture(const std::string& path, TextureLoader& loader, const TextureParams& params = TextureParams());
     ~Texture();
 
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+
     void Bind(unsigned int slot = 0) const;
-    void Unbind() const;
+    void Unbind(unsigned int slot = 0) const;
     
     unsigned int GetID() const { return m_textureID; }
     bool IsValid() const { return m_textureID != 0; }
+    bool IsLoaded() const { return m_loaded; }
     
     // Getters for texture properties
     int GetWidth() const { return m_width; }
     int GetHeight() const { return m_height; }
     int GetChannels() const { return m_channels; }
+    const std::string& GetPath() const { return m_filePath; }
 
 private:
+    friend class TextureLoader;
+
     unsigned int m_textureID;
     int m_width, m_height, m_channels;
     std::string m_filePath;
-};
\ No newline at end of file
+    TextureParams m_params;
+    TextureLoader* m_loader; // while the load is pending
+    bool m_loaded;           // m_textureID is owned by this texture
+
+    void LoadContainer();
+    void FinishLoad(unsigned int textureID, int width, int height, int channels);
+    void FailLoad();
+};
@@ -0,0 +1,44 @@
+#include "TextureCache.h"
+#include <filesystem>
+
+TextureCache::TextureCache(TextureLoader* loader) : m_loader(loader) {
+}
+
+std::string TextureCache::Key(const std::string& path, const TextureParams& params) {
+    // Different spellings of one file ("a/../b.png", "b.png") share an entry.
+    // A missing file keeps its normalised spelling and fails to load as usual.
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    if (error) {
+        canonical = std::filesystem::path(path).lexically_normal();
+    }
+    return canonical.generic_string() + "|" + std::to_string(params.wrap);
+}
+
+std::shared_ptr<Texture> TextureCache::Get(const std::string& path, const TextureParams& params) {
+    std::string key = Key(path, params);
+    auto found = m_entries.find(key);
+    if (found != m_entries.end()) {
+        if (std::shared_ptr<Texture> texture = found->second.lock()) {
+            m_hits++;
+            return texture;
+        }
+    }
+
+    // Misses are rare, so they also sweep out textures whose handles are gone
+    m_misses++;
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        it = it->second.expired() ? m_entries.erase(it) : std::next(it);
+    }
+    std::shared_ptr<Texture> texture(m_loader ? new Texture(path, *m_loader, params) : new Texture(path, params));
+    m_entries[key] = texture;
+    return texture;
+}
+
+int TextureCache::GetTextureCount() const {
+    int count = 0;
+    for (const auto& entry : m_entries) {
+        count += entry.second.expired() ? 0 : 1;
+    }
+    return count;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Texture.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class TextureLoader;
+
+// Hands out shared textures keyed by canonical path and params, so every
+// material naming the same file samples one GL texture and pays for its
+// memory once. The cache holds only weak references: a texture is deleted
+// when its last handle goes, and the next Get loads it again. Entries left
+// behind by deleted textures are dropped on the next miss.
+//
+// With a loader, textures load asynchronously through it; the loader must
+// then outlive every handle.
+class TextureCache {
+public:
+    explicit TextureCache(TextureLoader* loader = nullptr);
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    std::shared_ptr<Texture> Get(const std::string& path, const TextureParams& params = TextureParams());
+
+    // Textures alive through at least one handle
+    int GetTextureCount() const;
+    int GetHitCount() const { return m_hits; }
+    int GetMissCount() const { return m_misses; }
+
+private:
+    TextureLoader* m_loader;
+    std::unordered_map<std::string, std::weak_ptr<Texture>> m_entries;
+    int m_hits = 0;
+    int m_misses = 0;
+
+    static std::string Key(const std::string& path, const TextureParams& params);
+};
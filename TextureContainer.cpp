@@ -0,0 +1,286 @@
+#include "TextureContainer.h"
+#include "Renderer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+// Formats a 3.3 core loader does not declare
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+namespace {
+
+    struct BlockFormat {
+        GLenum internalFormat;
+        const char* name;
+        int channels;
+        size_t blockBytes; // per 4x4 block
+    };
+
+    const BlockFormat BC1_RGB = { GL_COMPRESSED_RGB_S3TC_DXT1_EXT, "BC1", 3, 8 };
+    const BlockFormat BC1_RGBA = { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, "BC1", 4, 8 };
+    const BlockFormat BC3 = { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, "BC3", 4, 16 };
+    const BlockFormat BC4 = { GL_COMPRESSED_RED_RGTC1, "BC4", 1, 8 };
+    const BlockFormat BC5 = { GL_COMPRESSED_RG_RGTC2, "BC5", 2, 16 };
+    const BlockFormat BC7 = { GL_COMPRESSED_RGBA_BPTC_UNORM, "BC7", 4, 16 };
+
+    constexpr uint32_t FourCC(char a, char b, char c, char d) {
+        return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+    }
+
+    const BlockFormat* DdsFourCCFormat(uint32_t fourCC) {
+        switch (fourCC) {
+        case FourCC('D', 'X', 'T', '1'): return &BC1_RGBA;
+        case FourCC('D', 'X', 'T', '5'): return &BC3;
+        case FourCC('A', 'T', 'I', '1'):
+        case FourCC('B', 'C', '4', 'U'): return &BC4;
+        case FourCC('A', 'T', 'I', '2'):
+        case FourCC('B', 'C', '5', 'U'): return &BC5;
+        default: return nullptr;
+        }
+    }
+
+    const BlockFormat* DxgiFormat(uint32_t format) {
+        switch (format) {
+        case 71: case 72: return &BC1_RGBA; // DXGI_FORMAT_BC1_UNORM(_SRGB)
+        case 77: case 78: return &BC3;
+        case 80: return &BC4;
+        case 83: return &BC5;
+        case 98: case 99: return &BC7;
+        default: return nullptr;
+        }
+    }
+
+    const BlockFormat* VkFormat(uint32_t format) {
+        switch (format) {
+        case 131: case 132: return &BC1_RGB; // VK_FORMAT_BC1_RGB_UNORM_BLOCK(_SRGB)
+        case 133: case 134: return &BC1_RGBA;
+        case 137: case 138: return &BC3;
+        case 139: return &BC4;
+        case 141: return &BC5;
+        case 145: case 146: return &BC7;
+        default: return nullptr;
+        }
+    }
+
+    // Both containers are little-endian
+    uint32_t Read32(const std::vector<unsigned char>& data, size_t offset) {
+        uint32_t value;
+        std::memcpy(&value, data.data() + offset, sizeof(value));
+        return value;
+    }
+
+    uint64_t Read64(const std::vector<unsigned char>& data, size_t offset) {
+        uint64_t value;
+        std::memcpy(&value, data.data() + offset, sizeof(value));
+        return value;
+    }
+
+    size_t LevelSize(const BlockFormat& format, int width, int height) {
+        return size_t((width + 3) / 4) * size_t((height + 3) / 4) * format.blockBytes;
+    }
+
+    void SetFormat(CompressedImage& image, const BlockFormat& format) {
+        image.internalFormat = format.internalFormat;
+        image.formatName = format.name;
+        image.channels = format.channels;
+    }
+
+    const size_t DDS_HEADER_END = 128;     // magic plus the 124-byte header
+    const size_t DDS_DX10_HEADER_END = 148;
+    const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+    const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+    const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+    bool ParseDds(const std::vector<unsigned char>& file, CompressedImage& image, std::string& error) {
+        if (file.size() < DDS_HEADER_END) {
+            error = "truncated DDS header";
+            return false;
+        }
+        uint32_t flags = Read32(file, 8);
+        int height = static_cast<int>(Read32(file, 12));
+        int width = static_cast<int>(Read32(file, 16));
+        uint32_t depth = Read32(file, 24);
+        uint32_t levelCount = (flags & DDSD_MIPMAPCOUNT) ? std::max(1u, Read32(file, 28)) : 1;
+        uint32_t fourCC = Read32(file, 84);
+        uint32_t caps2 = Read32(file, 112);
+        if ((caps2 & DDSCAPS2_CUBEMAP) || depth > 1) {
+            error = "only 2D DDS images are supported";
+            return false;
+        }
+
+        const BlockFormat* format = nullptr;
+        size_t dataOffset = DDS_HEADER_END;
+        if (fourCC == FourCC('D', 'X', '1', '0')) {
+            if (file.size() < DDS_DX10_HEADER_END) {
+                error = "truncated DX10 header";
+                return false;
+            }
+            if (Read32(file, 132) != DDS_DIMENSION_TEXTURE2D || (Read32(file, 136) & DDS_RESOURCE_MISC_TEXTURECUBE)) {
+                error = "only 2D DDS images are supported";
+                return false;
+            }
+            if (Read32(file, 140) > 1) {
+                error = "DDS texture arrays are not supported";
+                return false;
+            }
+            format = DxgiFormat(Read32(file, 128));
+            dataOffset = DDS_DX10_HEADER_END;
+        }
+        else {
+            format = DdsFourCCFormat(fourCC);
+        }
+        if (!format) {
+            error = "not a BC1/BC3/BC4/BC5/BC7 DDS";
+            return false;
+        }
+        if (width <= 0 || height <= 0) {
+            error = "bad DDS dimensions";
+            return false;
+        }
+
+        // Levels are packed back to back after the headers
+        SetFormat(image, *format);
+        size_t offset = dataOffset;
+        for (uint32_t i = 0; i < levelCount && (width >> i || height >> i); i++) {
+            int levelWidth = std::max(1, width >> i);
+            int levelHeight = std::max(1, height >> i);
+            size_t size = LevelSize(*format, levelWidth, levelHeight);
+            if (offset + size > file.size()) {
+                error = "truncated DDS level data";
+                return false;
+            }
+            image.levels.push_back({ offset - dataOffset, size, levelWidth, levelHeight });
+            offset += size;
+        }
+        image.data.assign(file.begin() + dataOffset, file.begin() + offset);
+        return true;
+    }
+
+    const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+    const size_t KTX2_LEVEL_INDEX = 80;
+    const size_t KTX2_LEVEL_ENTRY = 24; // byteOffset, byteLength, uncompressedByteLength
+
+    bool ParseKtx2(const std::vector<unsigned char>& file, CompressedImage& image, std::string& error) {
+        if (file.size() < KTX2_LEVEL_INDEX || std::memcmp(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+            error = "not a KTX2 file";
+            return false;
+        }
+        const BlockFormat* format = VkFormat(Read32(file, 12));
+        int width = static_cast<int>(Read32(file, 20));
+        int height = static_cast<int>(Read32(file, 24));
+        uint32_t depth = Read32(file, 28);
+        uint32_t layers = Read32(file, 32);
+        uint32_t faces = Read32(file, 36);
+        // Zero asks the loader to generate mips, which block formats cannot
+        uint32_t levelCount = std::max(1u, Read32(file, 40));
+        uint32_t supercompression = Read32(file, 44);
+
+        if (!format) {
+            error = "not a BC1/BC3/BC4/BC5/BC7 KTX2";
+            return false;
+        }
+        if (supercompression != 0) {
+            error = "supercompressed KTX2 is not supported";
+            return false;
+        }
+        if (depth > 0 || layers > 1 || faces != 1 || width <= 0 || height <= 0) {
+            error = "only 2D KTX2 images are supported";
+            return false;
+        }
+        if (file.size() < KTX2_LEVEL_INDEX + levelCount * KTX2_LEVEL_ENTRY) {
+            error = "truncated KTX2 level index";
+            return false;
+        }
+
+        // The level index is largest first; the data is usually stored
+        // smallest first, so copy level by level
+        SetFormat(image, *format);
+        for (uint32_t i = 0; i < levelCount && (width >> i || height >> i); i++) {
+            size_t entry = KTX2_LEVEL_INDEX + i * KTX2_LEVEL_ENTRY;
+            uint64_t offset = Read64(file, entry);
+            uint64_t length = Read64(file, entry + 8);
+            int levelWidth = std::max(1, width >> i);
+            int levelHeight = std::max(1, height >> i);
+            size_t size = LevelSize(*format, levelWidth, levelHeight);
+            if (length != size || offset > file.size() || length > file.size() - offset) {
+                error = "bad KTX2 level " + std::to_string(i);
+                return false;
+            }
+            image.levels.push_back({ image.data.size(), size, levelWidth, levelHeight });
+            image.data.insert(image.data.end(), file.begin() + offset, file.begin() + offset + length);
+        }
+        return true;
+    }
+
+    bool HasExtension(const std::string& path, const char* extension) {
+        size_t length = std::strlen(extension);
+        if (path.size() < length) return false;
+        return std::equal(path.end() - length, path.end(), extension,
+            [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; });
+    }
+
+}
+
+bool TextureContainer::IsContainer(const std::string& path) {
+    return HasExtension(path, ".dds") || HasExtension(path, ".ktx2");
+}
+
+bool TextureContainer::Load(const std::string& path, CompressedImage& image, std::string& error) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        error = "cannot open file";
+        return false;
+    }
+    std::vector<unsigned char> file((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+    image = CompressedImage();
+    if (HasExtension(path, ".dds")) {
+        if (file.size() < 4 || Read32(file, 0) != FourCC('D', 'D', 'S', ' ')) {
+            error = "not a DDS file";
+            return false;
+        }
+        return ParseDds(file, image, error);
+    }
+    return ParseKtx2(file, image, error);
+}
+
+bool TextureContainer::IsSupported(GLenum internalFormat) {
+    const RendererCaps& caps = Renderer::GetCaps();
+    switch (internalFormat) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return caps.textureS3TC;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        return caps.textureBPTC;
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_RG_RGTC2:
+        return true; // core since 3.0
+    default:
+        return false;
+    }
+}
+
+void TextureContainer::Upload(const CompressedImage& image) {
+    for (size_t i = 0; i < image.levels.size(); i++) {
+        const CompressedImage::Level& level = image.levels[i];
+        glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), image.internalFormat, level.width, level.height, 0,
+            static_cast<GLsizei>(level.size), image.data.data() + level.offset);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.levels.size()) - 1);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+// A block-compressed image with its mip chain, as stored in the file, ready
+// for glCompressedTexImage2D
+struct CompressedImage {
+    struct Level {
+        size_t offset; // into data
+        size_t size;
+        int width, height;
+    };
+
+    GLenum internalFormat = 0;
+    const char* formatName = "";
+    int channels = 0;
+    std::vector<unsigned char> data;
+    std::vector<Level> levels; // largest first
+};
+
+// Reader for DDS and KTX2 files holding BC1, BC3, BC4, BC5 or BC7 data.
+// Single 2D images only: no arrays, cube maps or supercompression.
+//
+// Blocks are uploaded as stored, and unlike the stb path they cannot be
+// flipped on load, so containers must be authored bottom row first (toktx
+// --lower_left_maps_to_s0t0, texconv -vflip). sRGB formats load as their
+// UNORM twins, since colour maps are sampled as linear everywhere else.
+class TextureContainer {
+public:
+    // Whether path names a DDS or KTX2 file, by extension
+    static bool IsContainer(const std::string& path);
+
+    // Parse a container. Touches no GL state, so workers may call it.
+    static bool Load(const std::string& path, CompressedImage& image, std::string& error);
+
+    // Whether the context can sample internalFormat
+    static bool IsSupported(GLenum internalFormat);
+
+    // Upload every level to the texture bound to GL_TEXTURE_2D on the active
+    // unit and limit sampling to the levels present
+    static void Upload(const CompressedImage& image);
+};
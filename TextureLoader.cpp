@@ -0,0 +1,336 @@
+#include "TextureLoader.h"
+#include "Texture.h"
+#include "Renderer.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+    GLenum FormatOf(int channels) {
+        switch (channels) {
+        case 1: return GL_RED;
+        case 2: return GL_RG;
+        case 4: return GL_RGBA;
+        default: return GL_RGB;
+        }
+    }
+
+}
+
+TextureLoader::TextureLoader(int workerCount) : m_placeholder(0) {
+    // Mid grey reads as a neutral material while the real maps stream in
+    const unsigned char grey[4] = { 128, 128, 128, 255 };
+    glGenTextures(1, &m_placeholder);
+    Renderer::BindTextureForUpdate(0, GL_TEXTURE_2D, m_placeholder);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    if (workerCount <= 0) {
+        int hardware = static_cast<int>(std::thread::hardware_concurrency());
+        workerCount = std::max(1, std::min(hardware - 1, 2));
+    }
+    for (int i = 0; i < workerCount; i++) {
+        m_workers.emplace_back(&TextureLoader::WorkerLoop, this);
+    }
+}
+
+TextureLoader::~TextureLoader() {
+    {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        m_stopping = true;
+        m_jobs.clear();
+    }
+    m_jobReady.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+
+    for (Image& image : m_results) FreeImage(image);
+    for (Image& image : m_decoded) FreeImage(image);
+    if (m_upload) {
+        FreeImage(m_upload->image);
+        glDeleteBuffers(1, &m_upload->pixelBuffer);
+        glDeleteTextures(1, &m_upload->texture);
+        Renderer::OnTextureDeleted(m_upload->texture);
+    }
+    glDeleteTextures(1, &m_placeholder);
+    Renderer::OnTextureDeleted(m_placeholder);
+}
+
+void TextureLoader::FreeImage(Image& image) {
+    stbi_image_free(image.pixels);
+    image.pixels = nullptr;
+    image.compressed = CompressedImage();
+}
+
+void TextureLoader::Load(Texture& texture, const std::string& path) {
+    unsigned int ticket = m_nextTicket++;
+    m_targets.push_back({ ticket, &texture });
+    {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        m_jobs.push_back({ ticket, path });
+    }
+    m_jobReady.notify_one();
+}
+
+void TextureLoader::Cancel(const Texture& texture) {
+    // The image, if it is still being decoded, is dropped when it arrives
+    m_targets.erase(std::remove_if(m_targets.begin(), m_targets.end(),
+        [&texture](const Target& target) { return target.texture == &texture; }), m_targets.end());
+
+    if (m_upload && m_upload->target == &texture) {
+        DiscardUpload();
+    }
+}
+
+void TextureLoader::SetUploadBudget(size_t bytesPerFrame) {
+    // Zero would never upload; one byte still moves a row a frame
+    m_uploadBudget = std::max<size_t>(bytesPerFrame, 1);
+}
+
+void TextureLoader::DiscardUpload() {
+    FreeImage(m_upload->image);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &m_upload->pixelBuffer);
+    glDeleteTextures(1, &m_upload->texture);
+    Renderer::OnTextureDeleted(m_upload->texture);
+    m_upload.reset();
+}
+
+void TextureLoader::FailUpload(const char* reason) {
+    std::cout << "Failed to load texture: " << m_upload->image.path << " (" << reason << ")" << std::endl;
+    m_upload->target->FailLoad();
+    DiscardUpload();
+}
+
+bool TextureLoader::Stage(size_t offset, const void* data, size_t size) {
+    // Each range is written once, so the map never has to wait for the GPU
+    void* staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!staging) return false;
+    std::memcpy(staging, data, size);
+    // False means the store was lost, e.g. to a mode switch
+    return glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+}
+
+Texture* TextureLoader::TakeTarget(unsigned int ticket) {
+    for (auto it = m_targets.begin(); it != m_targets.end(); ++it) {
+        if (it->ticket == ticket) {
+            Texture* texture = it->texture;
+            m_targets.erase(it);
+            return texture;
+        }
+    }
+    return nullptr;
+}
+
+void TextureLoader::WorkerLoop() {
+    // Per thread, so workers never race on stb's global flag
+    stbi_set_flip_vertically_on_load_thread(true);
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_jobMutex);
+            m_jobReady.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_stopping) return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        Image image;
+        image.ticket = job.ticket;
+        image.path = std::move(job.path);
+        if (TextureContainer::IsContainer(image.path)) {
+            if (TextureContainer::Load(image.path, image.compressed, image.error)) {
+                image.width = image.compressed.levels[0].width;
+                image.height = image.compressed.levels[0].height;
+                image.channels = image.compressed.channels;
+            }
+        }
+        else {
+            image.pixels = stbi_load(image.path.c_str(), &image.width, &image.height, &image.channels, 0);
+        }
+
+        std::lock_guard<std::mutex> lock(m_resultMutex);
+        m_results.push_back(std::move(image));
+    }
+}
+
+void TextureLoader::BeginUpload(Image& image, Texture* target) {
+    m_upload.reset(new Upload());
+    m_upload->image = std::move(image);
+    m_upload->target = target;
+    image.pixels = nullptr;
+
+    const Image& source = m_upload->image;
+    glGenTextures(1, &m_upload->texture);
+    glGenBuffers(1, &m_upload->pixelBuffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_upload->pixelBuffer);
+    if (source.IsCompressed()) {
+        // Each level gets its storage when its first row of blocks is due
+        m_upload->levelCount = static_cast<int>(source.compressed.levels.size());
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, source.compressed.data.size(), nullptr, GL_STREAM_DRAW);
+        return;
+    }
+
+    // Storage for level 0 now; rows arrive over the next frames
+    GLenum format = FormatOf(source.channels);
+    m_upload->rowCount = source.height;
+    Renderer::BindTextureForUpdate(0, GL_TEXTURE_2D, m_upload->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, source.width, source.height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (size_t)source.width * source.height * source.channels, nullptr, GL_STREAM_DRAW);
+}
+
+size_t TextureLoader::ContinueCompressedUpload(size_t budget) {
+    const CompressedImage& image = m_upload->image.compressed;
+    Upload& upload = *m_upload;
+    Renderer::BindTextureForUpdate(0, GL_TEXTURE_2D, upload.texture);
+
+    // Rows of 4x4 blocks, at least one, so a large level spreads over frames too
+    size_t uploaded = 0;
+    while (!upload.IsComplete()) {
+        const CompressedImage::Level& level = image.levels[upload.level];
+        upload.rowCount = (level.height + 3) / 4;
+        size_t rowBytes = level.size / upload.rowCount;
+        size_t remaining = budget > uploaded ? budget - uploaded : 0;
+        if (uploaded > 0 && remaining < rowBytes) break;
+
+        if (upload.rowsDone == 0) {
+            // Allocate the level with no pixel buffer bound, so nothing is read
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glCompressedTexImage2D(GL_TEXTURE_2D, upload.level, image.internalFormat, level.width, level.height, 0,
+                static_cast<GLsizei>(level.size), nullptr);
+        }
+
+        int rows = static_cast<int>(std::max<size_t>(1, remaining / rowBytes));
+        rows = std::min(rows, upload.rowCount - upload.rowsDone);
+        size_t offset = level.offset + upload.rowsDone * rowBytes;
+        size_t size = rows * rowBytes;
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.pixelBuffer);
+        if (!Stage(offset, image.data.data() + offset, size)) {
+            FailUpload("pixel buffer mapping failed");
+            return uploaded;
+        }
+        // The last row of blocks may cover fewer than four pixel rows
+        int y = upload.rowsDone * 4;
+        int height = std::min(rows * 4, level.height - y);
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, y, level.width, height, image.internalFormat,
+            static_cast<GLsizei>(size), (void*)offset);
+
+        uploaded += size;
+        upload.rowsDone += rows;
+        if (upload.rowsDone == upload.rowCount) {
+            upload.level++;
+            upload.rowsDone = 0;
+        }
+    }
+    return uploaded;
+}
+
+size_t TextureLoader::ContinueUpload(size_t budget) {
+    if (m_upload->image.IsCompressed()) {
+        return ContinueCompressedUpload(budget);
+    }
+
+    const Image& image = m_upload->image;
+    size_t rowBytes = (size_t)image.width * image.channels;
+
+    // At least one row, so a budget smaller than a row still makes progress
+    int rows = static_cast<int>(std::max<size_t>(1, budget / rowBytes));
+    rows = std::min(rows, image.height - m_upload->rowsDone);
+    size_t offset = m_upload->rowsDone * rowBytes;
+    size_t size = rows * rowBytes;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_upload->pixelBuffer);
+    if (!Stage(offset, image.pixels + offset, size)) {
+        FailUpload("pixel buffer mapping failed");
+        return 0;
+    }
+
+    // Rows are tightly packed, which breaks the default four-byte alignment for RGB
+    GLenum format = FormatOf(image.channels);
+    Renderer::BindTextureForUpdate(0, GL_TEXTURE_2D, m_upload->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, m_upload->rowsDone, image.width, rows, format, GL_UNSIGNED_BYTE, (void*)offset);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    m_upload->rowsDone += rows;
+    if (m_upload->rowsDone == m_upload->rowCount) {
+        m_upload->level++;
+    }
+    return size;
+}
+
+void TextureLoader::FinishUpload() {
+    Upload& upload = *m_upload;
+    Renderer::BindTextureForUpdate(0, GL_TEXTURE_2D, upload.texture);
+    if (upload.image.IsCompressed()) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, upload.levelCount - 1);
+    }
+    else {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, upload.target->m_params.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, upload.target->m_params.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glDeleteBuffers(1, &upload.pixelBuffer);
+    upload.target->FinishLoad(upload.texture, upload.image.width, upload.image.height, upload.image.channels);
+    std::cout << "Texture loaded successfully: " << upload.image.path << " (" << upload.image.width << "x"
+              << upload.image.height << ", " << upload.image.channels << " channels)" << std::endl;
+    FreeImage(upload.image);
+    m_upload.reset();
+}
+
+void TextureLoader::Update() {
+    {
+        std::lock_guard<std::mutex> lock(m_resultMutex);
+        for (Image& image : m_results) {
+            m_decoded.push_back(std::move(image));
+        }
+        m_results.clear();
+    }
+
+    size_t budget = m_uploadBudget;
+    m_uploadedBytes = 0;
+    while (budget > 0) {
+        if (!m_upload) {
+            if (m_decoded.empty()) break;
+            Image image = std::move(m_decoded.front());
+            m_decoded.pop_front();
+
+            // Textures destroyed while their file was decoding cost no budget
+            Texture* target = TakeTarget(image.ticket);
+            if (!target) {
+                FreeImage(image);
+                continue;
+            }
+            if (image.IsCompressed() && !TextureContainer::IsSupported(image.compressed.internalFormat)) {
+                image.error = std::string(image.compressed.formatName) + " is not supported by this context";
+                FreeImage(image);
+            }
+            if (!image.pixels && !image.IsCompressed()) {
+                std::cout << "Failed to load texture: " << image.path;
+                if (!image.error.empty()) std::cout << " (" << image.error << ")";
+                std::cout << std::endl;
+                target->FailLoad();
+                continue;
+            }
+            BeginUpload(image, target);
+        }
+
+        size_t uploaded = ContinueUpload(budget);
+        m_uploadedBytes += uploaded;
+        budget = uploaded < budget ? budget - uploaded : 0;
+        // A failed upload is gone already and the next image gets the rest
+        if (m_upload && m_upload->IsComplete()) {
+            FinishUpload();
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
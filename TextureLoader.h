@@ -0,0 +1,119 @@
+#pragma once
+
+#include "TextureContainer.h"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Texture;
+
+// Loads textures without stalling the render thread. Worker threads decode
+// the files; Update, called once a frame on the render thread, copies
+// decoded rows into a pixel buffer object and uploads them from it, at most
+// the byte budget per frame, so even a large image is spread over several
+// frames. The upload goes into a fresh texture that replaces the placeholder
+// only once it is complete, with mipmaps. Until then the Texture shows a
+// shared 1x1 grey placeholder. DDS and KTX2 files are read rather than
+// decoded and go up their stored mip levels a row of blocks at a time.
+//
+// The loader must outlive every Texture created through it.
+class TextureLoader {
+public:
+    // workerCount 0 picks one less than the hardware threads, at most two
+    explicit TextureLoader(int workerCount = 0);
+    ~TextureLoader();
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // Call once per frame on the render thread
+    void Update();
+
+    // At least one row (or row of blocks) goes up each frame whatever the budget
+    void SetUploadBudget(size_t bytesPerFrame);
+
+    unsigned int GetPlaceholder() const { return m_placeholder; }
+    int GetWorkerCount() const { return static_cast<int>(m_workers.size()); }
+    int GetPendingCount() const { return static_cast<int>(m_targets.size()); } // not yet uploading
+    int GetUploadingCount() const { return m_upload ? 1 : 0; }
+    size_t GetUploadedBytes() const { return m_uploadedBytes; } // last Update
+
+private:
+    friend class Texture;
+
+    struct Job {
+        unsigned int ticket;
+        std::string path;
+    };
+
+    struct Image {
+        unsigned int ticket = 0;
+        std::string path;
+        unsigned char* pixels = nullptr; // from stbi_load
+        int width = 0, height = 0, channels = 0;
+        CompressedImage compressed;      // from a container instead
+        std::string error;
+
+        bool IsCompressed() const { return !compressed.levels.empty(); }
+    };
+
+    // An image being uploaded, rowsDone rows of mip level `level` so far.
+    // Compressed levels count rows of 4x4 blocks.
+    struct Upload {
+        Image image;
+        Texture* target = nullptr;
+        unsigned int texture = 0;
+        unsigned int pixelBuffer = 0;
+        int level = 0;
+        int levelCount = 1;
+        int rowsDone = 0;
+        int rowCount = 0;
+
+        bool IsComplete() const { return level == levelCount; }
+    };
+
+    struct Target {
+        unsigned int ticket;
+        Texture* texture;
+    };
+
+    unsigned int m_placeholder;
+    std::vector<std::thread> m_workers;
+
+    // Shared with the workers
+    std::mutex m_jobMutex;
+    std::condition_variable m_jobReady;
+    std::deque<Job> m_jobs;
+    bool m_stopping = false;
+
+    std::mutex m_resultMutex;
+    std::vector<Image> m_results;
+
+    // Render thread only
+    unsigned int m_nextTicket = 1;
+    std::vector<Target> m_targets; // textures still waiting for their image
+    std::deque<Image> m_decoded;
+    std::unique_ptr<Upload> m_upload;
+    size_t m_uploadBudget = 4 * 1024 * 1024;
+    size_t m_uploadedBytes = 0;
+
+    // Called by Texture
+    void Load(Texture& texture, const std::string& path);
+    void Cancel(const Texture& texture);
+
+    void WorkerLoop();
+    Texture* TakeTarget(unsigned int ticket);
+    void BeginUpload(Image& image, Texture* target);
+    size_t ContinueUpload(size_t budget);
+    size_t ContinueCompressedUpload(size_t budget);
+    void FinishUpload();
+    void FailUpload(const char* reason);
+    void DiscardUpload();
+    bool Stage(size_t offset, const void* data, size_t size);
+    static void FreeImage(Image& image);
+};
@@ -0,0 +1,207 @@
+#include "World.h"
+#include "OcclusionCuller.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+    int FloorDiv(int a, int b) {
+        return (a >= 0 ? a : a - b + 1) / b;
+    }
+
+    // Occlusion state follows the chunk's coordinate rather than its scene
+    // handle, which the octree gives to another chunk once this one goes.
+    // 11 bits of x and z and 10 of y only wrap thousands of chunks apart.
+    uint32_t ChunkOcclusionIndex(const glm::ivec3& coord) {
+        return (uint32_t(coord.x) & 0x7FF) | (uint32_t(coord.z) & 0x7FF) << 11 | (uint32_t(coord.y) & 0x3FF) << 22;
+    }
+
+}
+
+World::~World() {
+    Clear();
+}
+
+glm::ivec3 World::ChunkCoordOf(const glm::ivec3& pos) {
+    return glm::ivec3(FloorDiv(pos.x, CHUNK_SIZE), FloorDiv(pos.y, CHUNK_SIZE), FloorDiv(pos.z, CHUNK_SIZE));
+}
+
+Chunk* World::FindChunk(const glm::ivec3& coord) const {
+    auto it = m_chunks.find(coord);
+    return it != m_chunks.end() ? it->second.get() : nullptr;
+}
+
+BlockType World::GetBlock(const glm::ivec3& pos) const {
+    glm::ivec3 coord = ChunkCoordOf(pos);
+    Chunk* chunk = FindChunk(coord);
+    if (!chunk) return BlockType::Air;
+
+    glm::ivec3 local = pos - coord * CHUNK_SIZE;
+    return chunk->GetBlock(local.x, local.y, local.z);
+}
+
+void World::SetBlock(const glm::ivec3& pos, BlockType type) {
+    glm::ivec3 coord = ChunkCoordOf(pos);
+    Chunk* chunk = FindChunk(coord);
+    if (!chunk) {
+        if (type == BlockType::Air) return;
+        chunk = new Chunk(coord);
+        m_chunks[coord].reset(chunk);
+    }
+
+    glm::ivec3 local = pos - coord * CHUNK_SIZE;
+    if (chunk->GetBlock(local.x, local.y, local.z) == type) return;
+    chunk->SetBlock(local.x, local.y, local.z, type);
+
+    // Blocks on a chunk border change which faces the neighbour exposes
+    for (int axis = 0; axis < 3; axis++) {
+        glm::ivec3 offset(0);
+        if (local[axis] == 0) offset[axis] = -1;
+        else if (local[axis] == CHUNK_SIZE - 1) offset[axis] = 1;
+        else continue;
+        MarkDirty(coord + offset);
+    }
+}
+
+void World::Clear() {
+    for (auto& entry : m_chunks) {
+        m_meshPool.Free(entry.second->GetMesh());
+    }
+    m_chunks.clear();
+    m_scene.Clear();
+    m_chunkByHandle.clear();
+}
+
+void World::UpdateSceneEntry(Chunk& chunk) {
+    bool meshed = chunk.GetMesh().IsValid();
+    SceneHandle handle = chunk.GetSceneHandle();
+
+    if (meshed && handle == INVALID_SCENE_HANDLE) {
+        handle = m_scene.Insert(chunk.GetBoundsCenter(), chunk.GetBoundsExtent(), 0);
+        if (handle >= m_chunkByHandle.size()) {
+            m_chunkByHandle.resize(handle + 1);
+        }
+        m_chunkByHandle[handle] = &chunk;
+        chunk.SetSceneHandle(handle);
+    }
+    else if (meshed) {
+        m_scene.Move(handle, chunk.GetBoundsCenter(), chunk.GetBoundsExtent());
+    }
+    else if (handle != INVALID_SCENE_HANDLE) {
+        m_scene.Remove(handle);
+        chunk.SetSceneHandle(INVALID_SCENE_HANDLE);
+    }
+}
+
+void World::MarkDirty(const glm::ivec3& coord) {
+    if (Chunk* chunk = FindChunk(coord)) {
+        chunk->MarkDirty();
+    }
+}
+
+void World::BuildPaddedVolume(const Chunk& chunk, std::vector<BlockType>& padded) const {
+    padded.assign(PADDED_CHUNK_VOLUME, BlockType::Air);
+    glm::ivec3 origin = chunk.GetOrigin();
+
+    for (int z = -1; z <= CHUNK_SIZE; z++) {
+        for (int y = -1; y <= CHUNK_SIZE; y++) {
+            for (int x = -1; x <= CHUNK_SIZE; x++) {
+                bool inside = x >= 0 && x < CHUNK_SIZE && y >= 0 && y < CHUNK_SIZE && z >= 0 && z < CHUNK_SIZE;
+                padded[PaddedIndex(x, y, z)] = inside
+                    ? chunk.GetBlock(x, y, z)
+                    : GetBlock(origin + glm::ivec3(x, y, z));
+            }
+        }
+    }
+}
+
+void World::UpdateMeshes() {
+    for (auto& entry : m_chunks) {
+        Chunk& chunk = *entry.second;
+        if (!chunk.IsDirty()) continue;
+
+        m_meshScratch.vertices.clear();
+        m_meshScratch.indices.clear();
+        if (!chunk.IsEmpty()) {
+            BuildPaddedVolume(chunk, m_paddedScratch);
+            ChunkMesher::Build(m_paddedScratch, glm::ivec3(0), m_meshScratch, chunk.GetCoord().y == WORLD_FLOOR_CHUNK_Y);
+        }
+        ApplyMesh(chunk, m_meshScratch);
+    }
+}
+
+void World::ApplyMesh(Chunk& chunk, const ChunkMeshData& mesh) {
+    m_meshPool.Free(chunk.GetMesh());
+    chunk.SetMesh(mesh.indices.empty() ? MeshRange() : m_meshPool.Allocate(mesh.vertices, mesh.indices));
+
+    if (chunk.GetMesh().IsValid()) {
+        // Tight bounds of the emitted faces, which are usually far smaller than the chunk
+        glm::vec3 low(static_cast<float>(CHUNK_SIZE)), high(-1.0f);
+        for (size_t i = 0; i < mesh.vertices.size(); i += 8) {
+            glm::vec3 position(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]);
+            low = glm::min(low, position);
+            high = glm::max(high, position);
+        }
+        chunk.SetBounds(glm::vec3(chunk.GetOrigin()) + (low + high) * 0.5f, (high - low) * 0.5f);
+    }
+    UpdateSceneEntry(chunk);
+}
+
+void World::AddChunk(std::unique_ptr<Chunk> chunk, const ChunkMeshData& mesh) {
+    glm::ivec3 coord = chunk->GetCoord();
+    RemoveChunk(coord);
+
+    Chunk& added = *chunk;
+    m_chunks[coord] = std::move(chunk);
+    ApplyMesh(added, mesh);
+}
+
+void World::RemoveChunk(const glm::ivec3& coord) {
+    auto it = m_chunks.find(coord);
+    if (it == m_chunks.end()) return;
+
+    Chunk& chunk = *it->second;
+    m_meshPool.Free(chunk.GetMesh());
+    if (chunk.GetSceneHandle() != INVALID_SCENE_HANDLE) {
+        m_scene.Remove(chunk.GetSceneHandle());
+        m_chunkByHandle[chunk.GetSceneHandle()] = nullptr;
+    }
+    m_chunks.erase(it);
+}
+
+void World::Enqueue(RenderQueue& queue, const RenderItem& chunkTemplate, const Frustum& frustum, OcclusionCuller* occlusion) {
+    m_drawCount = 0;
+
+    m_scene.Query(frustum, m_visibleChunks);
+    m_culledCount = m_scene.GetObjectCount() - static_cast<int>(m_visibleChunks.size());
+
+    RenderItem item = chunkTemplate;
+    item.vao = m_meshPool.GetVAO();
+
+    for (SceneHandle handle : m_visibleChunks) {
+        const Chunk& chunk = *m_chunkByHandle[handle];
+        const MeshRange& mesh = chunk.GetMesh();
+
+        // Meshes are built in chunk space; the per-draw model matrix places them
+        glm::vec3 origin = glm::vec3(chunk.GetOrigin());
+        item.indexCount = mesh.indexCount;
+        item.firstIndex = mesh.firstIndex;
+        item.baseVertex = (int)mesh.firstVertex;
+        item.data.model = glm::translate(glm::mat4(1.0f), origin);
+
+        if (occlusion) {
+            occlusion->Submit(queue, OcclusionId(OcclusionGroup::Chunks, ChunkOcclusionIndex(chunk.GetCoord())), item, chunk.GetBoundsCenter(), chunk.GetBoundsExtent());
+        }
+        else {
+            queue.Submit(RenderPass::Opaque, item, chunk.GetBoundsCenter());
+        }
+        m_drawCount++;
+    }
+}
+
+int World::GetTriangleCount() const {
+    int triangles = 0;
+    for (auto& entry : m_chunks) {
+        triangles += entry.second->GetIndexCount() / 3;
+    }
+    return triangles;
+}
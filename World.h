@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Chunk.h"
+#include "RenderQueue.h"
+#include "SceneOctree.h"
+#include <memory>
+#include <unordered_map>
+
+class OcclusionCuller;
+
+struct ChunkCoordHash {
+    size_t operator()(const glm::ivec3& c) const {
+        return ((size_t)c.x * 73856093u) ^ ((size_t)c.y * 19349663u) ^ ((size_t)c.z * 83492791u);
+    }
+};
+
+// Voxel world split into CHUNK_SIZE^3 chunks. Chunks are meshed lazily the
+// first time they are drawn and the mesh is cached until a block changes.
+// All chunk meshes share one MeshPool, so the whole world is a single VAO.
+// Meshed chunks are kept in a loose octree that drawing queries per frame.
+class World {
+public:
+    ~World();
+
+    BlockType GetBlock(const glm::ivec3& pos) const;
+    void SetBlock(const glm::ivec3& pos, BlockType type);
+    void Clear();
+
+    // Remesh dirty chunks into the mesh pool
+    void UpdateMeshes();
+
+    // Hand over a chunk whose blocks and mesh were built elsewhere, e.g. by the
+    // streamer's workers; its neighbours are not remeshed
+    void AddChunk(std::unique_ptr<Chunk> chunk, const ChunkMeshData& mesh);
+    void RemoveChunk(const glm::ivec3& coord);
+    bool HasChunk(const glm::ivec3& coord) const { return m_chunks.count(coord) != 0; }
+
+    // Queue one draw per non-empty chunk inside the frustum, using the template's
+    // shader and textures. With an occlusion culler the draws go through it.
+    void Enqueue(RenderQueue& queue, const RenderItem& chunkTemplate, const Frustum& frustum, OcclusionCuller* occlusion = nullptr);
+
+    unsigned int GetVAO() const { return m_meshPool.GetVAO(); }
+
+    int GetChunkCount() const { return static_cast<int>(m_chunks.size()); }
+    int GetTriangleCount() const;
+    int GetDrawCount() const { return m_drawCount; }
+    int GetCulledCount() const { return m_culledCount; }
+    const SceneOctree& GetSceneIndex() const { return m_scene; }
+
+    static glm::ivec3 ChunkCoordOf(const glm::ivec3& pos);
+
+private:
+    std::unordered_map<glm::ivec3, std::unique_ptr<Chunk>, ChunkCoordHash> m_chunks;
+    MeshPool m_meshPool;
+    std::vector<BlockType> m_paddedScratch;
+    ChunkMeshData m_meshScratch;
+    int m_drawCount = 0;
+    int m_culledCount = 0;
+
+    SceneOctree m_scene{ glm::vec3(0.0f), 1024.0f };
+    std::vector<const Chunk*> m_chunkByHandle;
+    std::vector<SceneHandle> m_visibleChunks;
+
+    Chunk* FindChunk(const glm::ivec3& coord) const;
+    void MarkDirty(const glm::ivec3& coord);
+    void BuildPaddedVolume(const Chunk& chunk, std::vector<BlockType>& padded) const;
+    void UpdateSceneEntry(Chunk& chunk);
+    void ApplyMesh(Chunk& chunk, const ChunkMeshData& mesh);
+};
@@ -0,0 +1,177 @@
+#include "WorldStreamer.h"
+#include <algorithm>
+
+namespace {
+
+    // The terrain is the flat ground the cube grid used to be: one layer of
+    // containers at y == 0, so only the chunk row at y == 0 has blocks
+    const int TERRAIN_CHUNK_Y = WORLD_FLOOR_CHUNK_Y;
+
+    BlockType TerrainBlock(const glm::ivec3& pos) {
+        return pos.y == 0 ? BlockType::Container : BlockType::Air;
+    }
+
+    int FloorDiv(int a, int b) {
+        return (a >= 0 ? a : a - b + 1) / b;
+    }
+
+}
+
+WorldStreamer::WorldStreamer(World& world, int workerCount)
+    : m_world(world)
+{
+    if (workerCount <= 0) {
+        int hardware = static_cast<int>(std::thread::hardware_concurrency());
+        workerCount = std::max(1, std::min(hardware - 1, 4));
+    }
+    for (int i = 0; i < workerCount; i++) {
+        m_workers.emplace_back(&WorldStreamer::WorkerLoop, this);
+    }
+}
+
+WorldStreamer::~WorldStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        m_stopping = true;
+        m_jobs.clear();
+    }
+    m_jobReady.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void WorldStreamer::SetLoadRadius(int radius) {
+    if (radius == m_loadRadius) return;
+    m_loadRadius = radius;
+    m_centerValid = false;
+}
+
+bool WorldStreamer::InRadius(const glm::ivec3& coord, int radius) const {
+    int dx = coord.x - m_center.x;
+    int dz = coord.z - m_center.z;
+    return dx * dx + dz * dz <= radius * radius;
+}
+
+void WorldStreamer::BuildChunk(const glm::ivec3& coord, Result& result, std::vector<BlockType>& padded) {
+    result.coord = coord;
+    result.chunk.reset(new Chunk(coord));
+
+    // The border comes from the generator too, so a chunk meshes the same
+    // whether or not its neighbours are loaded yet
+    glm::ivec3 origin = coord * CHUNK_SIZE;
+    padded.assign(PADDED_CHUNK_VOLUME, BlockType::Air);
+    for (int z = -1; z <= CHUNK_SIZE; z++) {
+        for (int y = -1; y <= CHUNK_SIZE; y++) {
+            for (int x = -1; x <= CHUNK_SIZE; x++) {
+                BlockType type = TerrainBlock(origin + glm::ivec3(x, y, z));
+                padded[PaddedIndex(x, y, z)] = type;
+
+                bool inside = x >= 0 && x < CHUNK_SIZE && y >= 0 && y < CHUNK_SIZE && z >= 0 && z < CHUNK_SIZE;
+                if (inside && type != BlockType::Air) {
+                    result.chunk->SetBlock(x, y, z, type);
+                }
+            }
+        }
+    }
+
+    if (!result.chunk->IsEmpty()) {
+        ChunkMesher::Build(padded, glm::ivec3(0), result.mesh, coord.y == WORLD_FLOOR_CHUNK_Y);
+    }
+}
+
+void WorldStreamer::WorkerLoop() {
+    std::vector<BlockType> padded;
+    for (;;) {
+        glm::ivec3 coord;
+        {
+            std::unique_lock<std::mutex> lock(m_jobMutex);
+            m_jobReady.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_stopping) return;
+            coord = m_jobs.front();
+            m_jobs.pop_front();
+        }
+
+        Result result;
+        BuildChunk(coord, result, padded);
+
+        std::lock_guard<std::mutex> lock(m_resultMutex);
+        m_results.push_back(std::move(result));
+    }
+}
+
+void WorldStreamer::Recenter() {
+    // Requeue from scratch so the nearest chunks to the new centre go first;
+    // jobs a worker already took stay requested and finish normally
+    {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        for (const glm::ivec3& coord : m_jobs) {
+            m_requested.erase(coord);
+        }
+        m_jobs.clear();
+    }
+
+    m_scratch.clear();
+    for (int z = -m_loadRadius; z <= m_loadRadius; z++) {
+        for (int x = -m_loadRadius; x <= m_loadRadius; x++) {
+            glm::ivec3 coord(m_center.x + x, TERRAIN_CHUNK_Y, m_center.z + z);
+            if (!InRadius(coord, m_loadRadius)) continue;
+            if (m_loaded.count(coord) || m_requested.count(coord)) continue;
+            m_scratch.push_back(coord);
+        }
+    }
+    std::sort(m_scratch.begin(), m_scratch.end(), [this](const glm::ivec3& a, const glm::ivec3& b) {
+        glm::ivec3 da = a - m_center, db = b - m_center;
+        return da.x * da.x + da.z * da.z < db.x * db.x + db.z * db.z;
+    });
+
+    if (!m_scratch.empty()) {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        m_jobs.insert(m_jobs.end(), m_scratch.begin(), m_scratch.end());
+    }
+    m_requested.insert(m_scratch.begin(), m_scratch.end());
+    m_jobReady.notify_all();
+
+    // Unload what has drifted past the hysteresis radius
+    for (auto it = m_loaded.begin(); it != m_loaded.end();) {
+        if (!InRadius(*it, m_loadRadius + m_unloadMargin)) {
+            m_world.RemoveChunk(*it);
+            it = m_loaded.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void WorldStreamer::Update(const glm::vec3& cameraPos) {
+    glm::ivec3 block = glm::ivec3(glm::floor(cameraPos));
+    glm::ivec3 center(FloorDiv(block.x, CHUNK_SIZE), TERRAIN_CHUNK_Y, FloorDiv(block.z, CHUNK_SIZE));
+    if (!m_centerValid || center != m_center) {
+        m_center = center;
+        m_centerValid = true;
+        Recenter();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_resultMutex);
+        for (Result& result : m_results) {
+            m_ready.push_back(std::move(result));
+        }
+        m_results.clear();
+    }
+
+    // Chunks the camera has left behind while they were built are dropped
+    // without costing any of the upload budget
+    m_uploadedCount = 0;
+    while (!m_ready.empty() && m_uploadedCount < m_uploadBudget) {
+        Result& result = m_ready.front();
+        m_requested.erase(result.coord);
+        if (InRadius(result.coord, m_loadRadius + m_unloadMargin)) {
+            m_world.AddChunk(std::move(result.chunk), result.mesh);
+            m_loaded.insert(result.coord);
+            m_uploadedCount++;
+        }
+        m_ready.pop_front();
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "World.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Keeps the chunks around the camera loaded. Worker threads generate the
+// terrain of a chunk and greedy-mesh it without touching the world; the
+// render thread only hands finished meshes to the world, a few per frame, so
+// a fast-moving camera never stalls on meshing. Chunks are requested nearest
+// first inside the load radius and unloaded once they fall outside the load
+// radius plus a margin, so walking back and forth over a chunk border does
+// not thrash.
+class WorldStreamer {
+public:
+    // workerCount 0 picks one less than the hardware threads, at most four
+    WorldStreamer(World& world, int workerCount = 0);
+    ~WorldStreamer();
+
+    WorldStreamer(const WorldStreamer&) = delete;
+    WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+    // Call once per frame on the render thread, before drawing the world
+    void Update(const glm::vec3& cameraPos);
+
+    // Radii are in chunks, measured in the xz plane
+    void SetLoadRadius(int radius);
+    int GetLoadRadius() const { return m_loadRadius; }
+    void SetUnloadMargin(int margin) { m_unloadMargin = margin; }
+
+    // Finished chunks handed to the world per frame
+    void SetUploadBudget(int chunksPerFrame) { m_uploadBudget = chunksPerFrame; }
+
+    int GetWorkerCount() const { return static_cast<int>(m_workers.size()); }
+    int GetPendingCount() const { return static_cast<int>(m_requested.size()); }
+    int GetLoadedCount() const { return static_cast<int>(m_loaded.size()); }
+    int GetUploadedCount() const { return m_uploadedCount; }
+
+private:
+    struct Result {
+        glm::ivec3 coord;
+        std::unique_ptr<Chunk> chunk;
+        ChunkMeshData mesh;
+    };
+
+    using CoordSet = std::unordered_set<glm::ivec3, ChunkCoordHash>;
+
+    World& m_world;
+    std::vector<std::thread> m_workers;
+
+    // Shared with the workers
+    std::mutex m_jobMutex;
+    std::condition_variable m_jobReady;
+    std::deque<glm::ivec3> m_jobs;
+    bool m_stopping = false;
+
+    std::mutex m_resultMutex;
+    std::vector<Result> m_results;
+
+    // Render thread only
+    CoordSet m_requested;           // queued, being built, or waiting for upload
+    CoordSet m_loaded;
+    std::deque<Result> m_ready;
+    std::vector<glm::ivec3> m_scratch;
+    glm::ivec3 m_center = glm::ivec3(0);
+    bool m_centerValid = false;
+
+    int m_loadRadius = 6;
+    int m_unloadMargin = 2;
+    int m_uploadBudget = 8;
+    int m_uploadedCount = 0;
+
+    void WorkerLoop();
+    void Recenter();
+    bool InRadius(const glm::ivec3& coord, int radius) const;
+    static void BuildChunk(const glm::ivec3& coord, Result& result, std::vector<BlockType>& padded);
+};
@@ -4,26 +4,60 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord;
+layout(location = 3) in mat4 aInstanceModel; // per-instance transform, locations 3-6
+layout(location = 7) in uint aDrawID;
+layout(location = 8) in mat3 aInstanceNormal; // per-instance normal matrix, locations 8-10
 
 uniform mat4 u_model;
-uniform mat4 u_view;
-uniform mat4 u_proj;
+uniform mat3 u_normalMatrix; // goes with u_model
+uniform bool u_instanced;
+uniform bool u_useDrawData;
+
+// Per-draw data: model matrix in texels 0-3, colour in 4, material in 5, normal matrix in 6-8
+uniform samplerBuffer u_drawData;
+const int DRAW_DATA_TEXELS = 9;
+
+// Shared by every program; bound once per frame at CAMERA_BLOCK_BINDING
+layout(std140) uniform CameraBlock {
+    mat4 u_view;
+    mat4 u_proj;
+    mat4 u_viewProj;
+    vec4 u_viewPos; // xyz
+};
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
+// Must match depth_prepass.glsl bit for bit, so GL_EQUAL passes after a pre-pass
+invariant gl_Position;
+
 void main() {
-    FragPos = vec3(u_model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(u_model))) * aNormal;
+    // Normal matrices come from the CPU; see NormalMatrices.h
+    mat4 model = u_instanced ? aInstanceModel : u_model;
+    mat3 normalMatrix = u_instanced ? aInstanceNormal : u_normalMatrix;
+    if (u_useDrawData) {
+        int base = int(aDrawID) * DRAW_DATA_TEXELS;
+        model = mat4(texelFetch(u_drawData, base), texelFetch(u_drawData, base + 1),
+                     texelFetch(u_drawData, base + 2), texelFetch(u_drawData, base + 3));
+        normalMatrix = mat3(texelFetch(u_drawData, base + 6).xyz, texelFetch(u_drawData, base + 7).xyz,
+                            texelFetch(u_drawData, base + 8).xyz);
+    }
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = normalMatrix * aNormal;
     TexCoords = aTexCoord;
-    gl_Position = u_proj * u_view * vec4(FragPos, 1.0);
+    gl_Position = u_viewProj * vec4(FragPos, 1.0);
 }
 
 #shader Fragment
 
 #version 330 core
 
+// Lighting permutations, injected by ShaderVariants:
+//   USE_DIRLIGHT      the directional light from the light block
+//   USE_POINT_LIGHTS  the point lights assigned to this fragment's cluster
+//   USE_SPOTLIGHT     the flashlight from the light block
+
 // Material properties
 struct Material {
     sampler2D diffuse;
@@ -31,45 +65,44 @@ struct Material {
     float shininess;
 };
 
+// Lights, laid out to match LightBlockData in Lighting.h; every member is a vec4 under std140
+
 // Directional light (like sun)
 struct DirLight {
-    vec3 direction;
+    vec4 direction;
 
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-// Point light (like light bulbs)
-struct PointLight {
-    vec3 position;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
 };
 
 // Spotlight (like flashlight)
 struct SpotLight {
-    vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
+    vec4 position;
+    vec4 direction;
+    vec4 attenuation; // constant, linear, quadratic
+    vec4 cutOff;      // cos inner, cos outer
+
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+};
+
+layout(std140) uniform LightBlock {
+    DirLight dirLight;
+    SpotLight spotLight;
 };
 
-#define NR_POINT_LIGHTS 4
+// Point lights (like light bulbs), two texels each: position and radius, colour
+uniform samplerBuffer u_pointLights;
+
+// Clusters, laid out to match ClusterBlockData in LightClusters.h
+layout(std140) uniform ClusterBlock {
+    ivec4 u_clusterGrid;  // tiles x, tiles y, depth slices
+    vec4 u_clusterScale;  // tiles per pixel x and y, slice scale, slice bias
+};
+uniform usamplerBuffer u_clusterTable;  // first index and light count per cluster
+uniform usamplerBuffer u_clusterLights; // point light indices, grouped by cluster
 
 in vec3 FragPos;
 in vec3 Normal;
@@ -77,19 +110,22 @@ in vec2 TexCoords;
 
 out vec4 FragColor;
 
-uniform vec3 viewPos;
+layout(std140) uniform CameraBlock {
+    mat4 u_view;
+    mat4 u_proj;
+    mat4 u_viewProj;
+    vec4 u_viewPos; // xyz
+};
+
 uniform Material material;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
 
 // Function prototypes
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcPointLight(vec4 positionRadius, vec3 color, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
-    vec3 lightDir = normalize(-light.direction);
+    vec3 lightDir = normalize(-light.direction.xyz);
 
     // Diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
@@ -99,15 +135,15 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
 
     // Combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient.rgb * vec3(texture(material.diffuse, TexCoords));
+    vec3 diffuse = light.diffuse.rgb * diff * vec3(texture(material.diffuse, TexCoords));
+    vec3 specular = light.specular.rgb * spec * vec3(texture(material.specular, TexCoords));
 
     return (ambient + diffuse + specular);
 }
 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
-    vec3 lightDir = normalize(light.position - fragPos);
+vec3 CalcPointLight(vec4 positionRadius, vec3 color, vec3 normal, vec3 fragPos, vec3 viewDir) {
+    vec3 lightDir = normalize(positionRadius.xyz - fragPos);
 
     // Diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
@@ -116,14 +152,16 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
 
-    // Attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // Attenuation, windowed to reach zero at the radius the light was clustered with
+    float distance = length(positionRadius.xyz - fragPos);
+    float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.032 * (distance * distance));
+    float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
 
     // Combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = 0.1 * color * vec3(texture(material.diffuse, TexCoords));
+    vec3 diffuse = color * diff * vec3(texture(material.diffuse, TexCoords));
+    vec3 specular = vec3(spec) * vec3(texture(material.specular, TexCoords));
 
     ambient *= attenuation;
     diffuse *= attenuation;
@@ -133,7 +171,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
 }
 
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
-    vec3 lightDir = normalize(light.position - fragPos);
+    vec3 lightDir = normalize(light.position.xyz - fragPos);
 
     // Diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
@@ -143,22 +181,22 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
 
     // Attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float distance = length(light.position.xyz - fragPos);
+    float attenuation = 1.0 / (light.attenuation.x + light.attenuation.y * distance + light.attenuation.z * (distance * distance));
 
     // Spotlight intensity with exponential falloff
-    float theta = dot(lightDir, normalize(-light.direction));
-    float epsilon = light.cutOff - light.outerCutOff;
-    float rawIntensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    float theta = dot(lightDir, normalize(-light.direction.xyz));
+    float epsilon = light.cutOff.x - light.cutOff.y;
+    float rawIntensity = clamp((theta - light.cutOff.y) / epsilon, 0.0, 1.0);
 
     // Exponential falloff for more natural look
     float intensity = smoothstep(0.0, 1.0, rawIntensity);
     // Alternative: float intensity = pow(rawIntensity, 2.0); // Quadratic falloff
 
     // Combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient.rgb * vec3(texture(material.diffuse, TexCoords));
+    vec3 diffuse = light.diffuse.rgb * diff * vec3(texture(material.diffuse, TexCoords));
+    vec3 specular = light.specular.rgb * spec * vec3(texture(material.specular, TexCoords));
 
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
@@ -167,19 +205,38 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     return (ambient + diffuse + specular);
 }
 
+int ClusterIndex() {
+    float depth = -(u_view * vec4(FragPos, 1.0)).z;
+    vec3 cell = vec3(gl_FragCoord.xy * u_clusterScale.xy, log(depth) * u_clusterScale.z + u_clusterScale.w);
+    ivec3 clamped = clamp(ivec3(floor(cell)), ivec3(0), u_clusterGrid.xyz - 1);
+    return clamped.x + u_clusterGrid.x * (clamped.y + u_clusterGrid.y * clamped.z);
+}
+
 void main() {
     // Properties
     vec3 norm = normalize(Normal);
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(u_viewPos.xyz - FragPos);
+
+    vec3 result = vec3(0.0);
 
     // Phase 1: directional lighting
-    //vec3 result = CalcDirLight(dirLight, norm, viewDir);
-	vec3 result = vec3(0.0);
-    // Phase 2: point lights
-    for (int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+#ifdef USE_DIRLIGHT
+    result += CalcDirLight(dirLight, norm, viewDir);
+#endif
+
+    // Phase 2: point lights, only those assigned to this fragment's cluster
+#ifdef USE_POINT_LIGHTS
+    uvec2 cluster = texelFetch(u_clusterTable, ClusterIndex()).rg;
+    for (uint i = 0u; i < cluster.y; i++) {
+        int light = int(texelFetch(u_clusterLights, int(cluster.x + i)).r);
+        result += CalcPointLight(texelFetch(u_pointLights, light * 2), texelFetch(u_pointLights, light * 2 + 1).rgb,
+                                 norm, FragPos, viewDir);
+    }
+#endif
 
     // Phase 3: spot light
+#ifdef USE_SPOTLIGHT
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
+#endif
     FragColor = vec4(result, 1.0);
 }
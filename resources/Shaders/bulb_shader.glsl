@@ -2,25 +2,49 @@
 
 #version 330 core
 layout(location = 0) in vec3 lightPos;
+layout(location = 7) in uint aDrawID;
 
-uniform mat4 u_model;
-uniform mat4 u_view;
-uniform mat4 u_proj;
+// Same layout as CameraBlock in Basic_shader.glsl
+layout(std140) uniform CameraBlock {
+	mat4 u_view;
+	mat4 u_proj;
+	mat4 u_viewProj;
+	vec4 u_viewPos; // xyz
+};
+
+// Per-draw data: model matrix in texels 0-3, colour in 4, material in 5, normal matrix in 6-8
+uniform samplerBuffer u_drawData;
+const int DRAW_DATA_TEXELS = 9;
+
+flat out vec3 BulbColor;
+
+// See Basic_shader.glsl
+invariant gl_Position;
 
 void main()
 {
-	gl_Position = u_proj* u_view*u_model*vec4(lightPos, 1.0f);
+	int base = int(aDrawID) * DRAW_DATA_TEXELS;
+	mat4 model = mat4(texelFetch(u_drawData, base), texelFetch(u_drawData, base + 1),
+	                  texelFetch(u_drawData, base + 2), texelFetch(u_drawData, base + 3));
+	BulbColor = texelFetch(u_drawData, base + 4).rgb;
+	vec3 worldPos = vec3(model * vec4(lightPos, 1.0));
+	gl_Position = u_viewProj * vec4(worldPos, 1.0);
 }
 
 #shader Fragment
 
 #version 330 core
 
-uniform vec3 lightColor;
+flat in vec3 BulbColor;
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+// G-buffer targets on the deferred path; bulbs are lit already
+layout(location = 1) out vec4 AlbedoSpec;
+layout(location = 2) out vec4 NormalShade;
 
 void main(){
-	FragColor = vec4(lightColor, 1.0);
+	FragColor = vec4(BulbColor, 1.0);
+	AlbedoSpec = vec4(0.0);
+	NormalShade = vec4(0.0);
 }
 
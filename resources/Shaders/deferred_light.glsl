@@ -0,0 +1,101 @@
+#shader Vertex
+
+#version 330 core
+
+// Fullscreen triangle from gl_VertexID; no vertex buffers
+void main() {
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+
+#shader Fragment
+
+#version 330 core
+
+// Lighting pass of the deferred path, once per pixel: the colour the geometry
+// pass left plus the flashlight. Point lights are added by deferred_point_light.glsl.
+
+// Same layouts as LightBlock in Basic_shader.glsl
+struct DirLight {
+    vec4 direction;
+
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+};
+
+struct SpotLight {
+    vec4 position;
+    vec4 direction;
+    vec4 attenuation; // constant, linear, quadratic
+    vec4 cutOff;      // cos inner, cos outer
+
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+};
+
+layout(std140) uniform LightBlock {
+    DirLight dirLight;
+    SpotLight spotLight;
+};
+
+// Same layout as CameraBlock in Basic_shader.glsl
+layout(std140) uniform CameraBlock {
+    mat4 u_view;
+    mat4 u_proj;
+    mat4 u_viewProj;
+    vec4 u_viewPos; // xyz
+};
+
+// G-buffer, see gbuffer_shader.glsl
+uniform sampler2D u_gColor;
+uniform sampler2D u_gAlbedoSpec;
+uniform sampler2D u_gNormal;
+uniform sampler2D u_gDepth;
+
+uniform mat4 u_invViewProj;
+uniform float u_shininess;
+
+out vec4 FragColor;
+
+vec3 WorldPosition(ivec2 pixel, float depth) {
+    vec2 ndc = (vec2(pixel) + 0.5) / vec2(textureSize(u_gDepth, 0)) * 2.0 - 1.0;
+    vec4 world = u_invViewProj * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    return world.xyz / world.w;
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 color = texelFetch(u_gColor, pixel, 0);
+    vec4 normalShade = texelFetch(u_gNormal, pixel, 0);
+    if (normalShade.a == 0.0) {
+        // Background, or a surface its own program lit
+        FragColor = color;
+        return;
+    }
+
+    vec4 albedoSpec = texelFetch(u_gAlbedoSpec, pixel, 0);
+    vec3 normal = normalize(normalShade.xyz * 2.0 - 1.0);
+    vec3 fragPos = WorldPosition(pixel, texelFetch(u_gDepth, pixel, 0).r);
+    vec3 viewDir = normalize(u_viewPos.xyz - fragPos);
+    vec3 lightDir = normalize(spotLight.position.xyz - fragPos);
+
+    // Same terms as CalcSpotLight in Basic_shader.glsl
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), u_shininess);
+
+    float distance = length(spotLight.position.xyz - fragPos);
+    float attenuation = 1.0 / (spotLight.attenuation.x + spotLight.attenuation.y * distance + spotLight.attenuation.z * (distance * distance));
+
+    float theta = dot(lightDir, normalize(-spotLight.direction.xyz));
+    float epsilon = spotLight.cutOff.x - spotLight.cutOff.y;
+    float intensity = smoothstep(0.0, 1.0, clamp((theta - spotLight.cutOff.y) / epsilon, 0.0, 1.0));
+
+    vec3 ambient = spotLight.ambient.rgb * albedoSpec.rgb;
+    vec3 diffuse = spotLight.diffuse.rgb * diff * albedoSpec.rgb;
+    vec3 specular = spotLight.specular.rgb * spec * albedoSpec.a;
+
+    FragColor = vec4(color.rgb + (ambient + diffuse + specular) * attenuation * intensity, 1.0);
+}
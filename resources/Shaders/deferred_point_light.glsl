@@ -0,0 +1,113 @@
+#shader Vertex
+
+#version 330 core
+
+// One instance per point light: a screen rectangle around the light's sphere,
+// so only pixels the light can reach are shaded. The bounds are the ones
+// LightClusters uses for its tiles.
+
+// Point lights, two texels each: position and radius, colour
+uniform samplerBuffer u_pointLights;
+
+// Same layout as CameraBlock in Basic_shader.glsl
+layout(std140) uniform CameraBlock {
+    mat4 u_view;
+    mat4 u_proj;
+    mat4 u_viewProj;
+    vec4 u_viewPos; // xyz
+};
+
+flat out int LightIndex;
+
+void main() {
+    LightIndex = gl_InstanceID;
+    vec4 positionRadius = texelFetch(u_pointLights, gl_InstanceID * 2);
+    vec3 center = (u_view * vec4(positionRadius.xyz, 1.0)).xyz;
+    float radius = positionRadius.w;
+
+    float nearPlane = u_proj[3][2] / (u_proj[2][2] - 1.0);
+    float farPlane = u_proj[3][2] / (u_proj[2][2] + 1.0);
+    float depth = -center.z;
+    float depthMin = max(depth - radius, nearPlane);
+    float depthMax = depth + radius;
+    if (depthMax < nearPlane || depthMin > farPlane) {
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0); // clipped
+        return;
+    }
+
+    // Each edge is divided by the depth that pushes it further out
+    vec2 scale = vec2(u_proj[0][0], u_proj[1][1]);
+    vec2 lo = center.xy - radius;
+    vec2 hi = center.xy + radius;
+    vec2 ndcMin = lo * scale / mix(vec2(depthMax), vec2(depthMin), lessThan(lo, vec2(0.0)));
+    vec2 ndcMax = hi * scale / mix(vec2(depthMax), vec2(depthMin), greaterThan(hi, vec2(0.0)));
+
+    // Triangle strip corners; a light off screen collapses to an edge and covers nothing
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    gl_Position = vec4(mix(clamp(ndcMin, -1.0, 1.0), clamp(ndcMax, -1.0, 1.0), corner), 0.0, 1.0);
+}
+
+#shader Fragment
+
+#version 330 core
+
+uniform samplerBuffer u_pointLights;
+
+// Same layout as CameraBlock in Basic_shader.glsl
+layout(std140) uniform CameraBlock {
+    mat4 u_view;
+    mat4 u_proj;
+    mat4 u_viewProj;
+    vec4 u_viewPos; // xyz
+};
+
+// G-buffer, see gbuffer_shader.glsl
+uniform sampler2D u_gAlbedoSpec;
+uniform sampler2D u_gNormal;
+uniform sampler2D u_gDepth;
+
+uniform mat4 u_invViewProj;
+uniform float u_shininess;
+
+flat in int LightIndex;
+
+out vec4 FragColor;
+
+vec3 WorldPosition(ivec2 pixel, float depth) {
+    vec2 ndc = (vec2(pixel) + 0.5) / vec2(textureSize(u_gDepth, 0)) * 2.0 - 1.0;
+    vec4 world = u_invViewProj * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    return world.xyz / world.w;
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 normalShade = texelFetch(u_gNormal, pixel, 0);
+    if (normalShade.a == 0.0) discard;
+
+    vec3 fragPos = WorldPosition(pixel, texelFetch(u_gDepth, pixel, 0).r);
+    vec4 positionRadius = texelFetch(u_pointLights, LightIndex * 2);
+    float distance = length(positionRadius.xyz - fragPos);
+    if (distance >= positionRadius.w) discard;
+
+    vec3 color = texelFetch(u_pointLights, LightIndex * 2 + 1).rgb;
+    vec4 albedoSpec = texelFetch(u_gAlbedoSpec, pixel, 0);
+    vec3 normal = normalize(normalShade.xyz * 2.0 - 1.0);
+    vec3 viewDir = normalize(u_viewPos.xyz - fragPos);
+    vec3 lightDir = normalize(positionRadius.xyz - fragPos);
+
+    // Same terms as CalcPointLight in Basic_shader.glsl
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), u_shininess);
+
+    float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.032 * (distance * distance));
+    float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
+
+    vec3 ambient = 0.1 * color * albedoSpec.rgb;
+    vec3 diffuse = color * diff * albedoSpec.rgb;
+    vec3 specular = vec3(spec * albedoSpec.a);
+
+    // Added onto the base pass with additive blending
+    FragColor = vec4((ambient + diffuse + specular) * attenuation, 1.0);
+}
@@ -0,0 +1,47 @@
+#shader Vertex
+
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 3) in mat4 aInstanceModel; // per-instance transform, locations 3-6
+layout(location = 7) in uint aDrawID;
+
+// Depth pre-pass for every opaque program. The model matrix comes from the
+// same place as in Basic_shader.glsl, and gl_Position is computed with the
+// same expression in every scene program, so the colour pass can test GL_EQUAL.
+
+uniform mat4 u_model;
+uniform bool u_instanced;
+uniform bool u_useDrawData;
+
+// Per-draw data: model matrix in texels 0-3, colour in 4, material in 5, normal matrix in 6-8
+uniform samplerBuffer u_drawData;
+const int DRAW_DATA_TEXELS = 9;
+
+// Same layout as CameraBlock in Basic_shader.glsl
+layout(std140) uniform CameraBlock {
+    mat4 u_view;
+    mat4 u_proj;
+    mat4 u_viewProj;
+    vec4 u_viewPos; // xyz
+};
+
+invariant gl_Position;
+
+void main() {
+    mat4 model = u_instanced ? aInstanceModel : u_model;
+    if (u_useDrawData) {
+        int base = int(aDrawID) * DRAW_DATA_TEXELS;
+        model = mat4(texelFetch(u_drawData, base), texelFetch(u_drawData, base + 1),
+                     texelFetch(u_drawData, base + 2), texelFetch(u_drawData, base + 3));
+    }
+    vec3 worldPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = u_viewProj * vec4(worldPos, 1.0);
+}
+
+#shader Fragment
+
+#version 330 core
+
+// Depth only; colour writes are masked off
+void main() {
+}
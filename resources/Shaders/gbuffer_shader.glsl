@@ -0,0 +1,82 @@
+#shader Vertex
+
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoord;
+layout(location = 3) in mat4 aInstanceModel; // per-instance transform, locations 3-6
+layout(location = 7) in uint aDrawID;
+layout(location = 8) in mat3 aInstanceNormal; // per-instance normal matrix, locations 8-10
+
+uniform mat4 u_model;
+uniform mat3 u_normalMatrix; // goes with u_model
+uniform bool u_instanced;
+uniform bool u_useDrawData;
+
+// Per-draw data: model matrix in texels 0-3, colour in 4, material in 5, normal matrix in 6-8
+uniform samplerBuffer u_drawData;
+const int DRAW_DATA_TEXELS = 9;
+
+// Same layout as CameraBlock in Basic_shader.glsl
+layout(std140) uniform CameraBlock {
+    mat4 u_view;
+    mat4 u_proj;
+    mat4 u_viewProj;
+    vec4 u_viewPos; // xyz
+};
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+// See Basic_shader.glsl
+invariant gl_Position;
+
+void main() {
+    // Normal matrices come from the CPU; see NormalMatrices.h
+    mat4 model = u_instanced ? aInstanceModel : u_model;
+    mat3 normalMatrix = u_instanced ? aInstanceNormal : u_normalMatrix;
+    if (u_useDrawData) {
+        int base = int(aDrawID) * DRAW_DATA_TEXELS;
+        model = mat4(texelFetch(u_drawData, base), texelFetch(u_drawData, base + 1),
+                     texelFetch(u_drawData, base + 2), texelFetch(u_drawData, base + 3));
+        normalMatrix = mat3(texelFetch(u_drawData, base + 6).xyz, texelFetch(u_drawData, base + 7).xyz,
+                            texelFetch(u_drawData, base + 8).xyz);
+    }
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = normalMatrix * aNormal;
+    TexCoords = aTexCoord;
+    gl_Position = u_viewProj * vec4(FragPos, 1.0);
+}
+
+#shader Fragment
+
+#version 330 core
+
+// Geometry pass of the deferred path. Every opaque program writes the same
+// three targets while the G-buffer is bound:
+//   0  colour the surface already has (RGBA8); black where the lighting pass shades
+//   1  albedo and specular intensity (RGBA8)
+//   2  normal * 0.5 + 0.5, alpha 1 where the lighting pass shades (RGB10_A2)
+// Position is rebuilt from the depth attachment.
+layout(location = 0) out vec4 Color;
+layout(location = 1) out vec4 AlbedoSpec;
+layout(location = 2) out vec4 NormalShade;
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+uniform Material material;
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+void main() {
+    Color = vec4(0.0, 0.0, 0.0, 1.0);
+    AlbedoSpec = vec4(texture(material.diffuse, TexCoords).rgb, texture(material.specular, TexCoords).r);
+    NormalShade = vec4(normalize(Normal) * 0.5 + 0.5, 1.0);
+}
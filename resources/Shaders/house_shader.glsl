@@ -4,70 +4,104 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord;
+layout(location = 7) in uint aDrawID;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+flat out vec3 MaterialDiffuse;
+flat out vec4 MaterialSpecular; // rgb specular, a shininess
 
-uniform mat4 u_model;
-uniform mat4 u_view;
-uniform mat4 u_proj;
+// See Basic_shader.glsl
+invariant gl_Position;
+
+// Shared by every program; bound once per frame at CAMERA_BLOCK_BINDING
+layout(std140) uniform CameraBlock {
+    mat4 u_view;
+    mat4 u_proj;
+    mat4 u_viewProj;
+    vec4 u_viewPos; // xyz
+};
+
+// Per-draw data: model matrix in texels 0-3, colour in 4, material in 5, normal matrix in 6-8
+uniform samplerBuffer u_drawData;
+const int DRAW_DATA_TEXELS = 9;
 
 void main()
 {
-    FragPos = vec3(u_model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(u_model))) * aNormal;
+    int base = int(aDrawID) * DRAW_DATA_TEXELS;
+    mat4 model = mat4(texelFetch(u_drawData, base), texelFetch(u_drawData, base + 1),
+                      texelFetch(u_drawData, base + 2), texelFetch(u_drawData, base + 3));
+    MaterialDiffuse = texelFetch(u_drawData, base + 4).rgb;
+    MaterialSpecular = texelFetch(u_drawData, base + 5);
+    mat3 normalMatrix = mat3(texelFetch(u_drawData, base + 6).xyz, texelFetch(u_drawData, base + 7).xyz,
+                             texelFetch(u_drawData, base + 8).xyz);
+
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = normalMatrix * aNormal;
     TexCoords = aTexCoord;
 
-    gl_Position = u_proj * u_view * vec4(FragPos, 1.0);
+    gl_Position = u_viewProj * vec4(FragPos, 1.0);
 }
 
 #shader Fragment
 
 #version 330 core
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+// G-buffer targets on the deferred path; the house lights itself
+layout(location = 1) out vec4 AlbedoSpec;
+layout(location = 2) out vec4 NormalShade;
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
+flat in vec3 MaterialDiffuse;
+flat in vec4 MaterialSpecular;
 
-uniform bool hasTexture;
+// HAS_TEXTURE, injected by ShaderVariants, reads the diffuse map instead of the .mtl colour
 uniform sampler2D texture_diffuse1;
+// HAS_SPECULAR_MAP scales the .mtl specular colour by the map_Ks map
+uniform sampler2D texture_specular1;
 
-uniform vec3 materialDiffuse;
-uniform vec3 materialSpecular;
-uniform float materialShininess;
+uniform vec3 lightColor; // a flashlight at the camera
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform vec3 lightColor;
+layout(std140) uniform CameraBlock {
+    mat4 u_view;
+    mat4 u_proj;
+    mat4 u_viewProj;
+    vec4 u_viewPos; // xyz
+};
 
 void main()
 {
-    vec3 baseColor;
-    if (hasTexture) {
-        baseColor = texture(texture_diffuse1, TexCoords).rgb;
-    }
-    else {
-        baseColor = materialDiffuse; // fallback to .mtl color
-    }
+#ifdef HAS_TEXTURE
+    vec3 baseColor = texture(texture_diffuse1, TexCoords).rgb;
+#else
+    vec3 baseColor = MaterialDiffuse; // fallback to .mtl color
+#endif
 
     // ambient
     vec3 ambient = 0.2 * lightColor * baseColor;
 
     // diffuse
     vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(lightPos - FragPos);
+    vec3 lightDir = normalize(u_viewPos.xyz - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
     vec3 diffuse = diff * lightColor * baseColor;
 
     // specular
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(u_viewPos.xyz - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), materialShininess);
-    vec3 specular = materialSpecular * spec * lightColor;
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), MaterialSpecular.a);
+    vec3 specularColor = MaterialSpecular.rgb;
+#ifdef HAS_SPECULAR_MAP
+    specularColor *= texture(texture_specular1, TexCoords).rgb;
+#endif
+    vec3 specular = specularColor * spec * lightColor;
 
     vec3 result = ambient + diffuse + specular;
     FragColor = vec4(result, 1.0);
+    AlbedoSpec = vec4(0.0);
+    NormalShade = vec4(0.0);
 }
 
@@ -0,0 +1,32 @@
+#shader Vertex
+
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+// Same layout as CameraBlock in Basic_shader.glsl
+layout(std140) uniform CameraBlock {
+	mat4 u_view;
+	mat4 u_proj;
+	mat4 u_viewProj;
+	vec4 u_viewPos; // xyz
+};
+
+uniform vec3 u_boxCenter;
+uniform vec3 u_boxExtent;
+
+// Unit cube scaled and moved onto the box being tested
+void main()
+{
+	gl_Position = u_viewProj * vec4(u_boxCenter + aPos * u_boxExtent, 1.0);
+}
+
+#shader Fragment
+
+#version 330 core
+
+out vec4 FragColor;
+
+// Colour writes are masked off; only the samples passing the depth test count
+void main(){
+	FragColor = vec4(1.0);
+}
\ No newline at end of file
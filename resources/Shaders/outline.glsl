@@ -4,12 +4,18 @@
 layout(location = 0) in vec3 aPos;
 
 uniform mat4 u_model;
-uniform mat4 u_view;
-uniform mat4 u_proj;
+
+// Same layout as CameraBlock in Basic_shader.glsl
+layout(std140) uniform CameraBlock {
+	mat4 u_view;
+	mat4 u_proj;
+	mat4 u_viewProj;
+	vec4 u_viewPos; // xyz
+};
 
 void main()
 {
-	gl_Position = u_proj * u_view * u_model * vec4(aPos, 1.0f);
+	gl_Position = u_viewProj * u_model * vec4(aPos, 1.0f);
 }
 
 #shader Fragment